@@ -0,0 +1,130 @@
+#/bin/bash
+
+# this script runs martycam_headless against an MJPEG file for a set of thread counts, once with the
+# decoding done in the capture (readahead=1) and once decoded in parallel on the compute pool, and
+# collects the capture frame rate into a single table.
+
+### ===========================================================
+###                        INPUT PARAMETERS
+### ===========================================================
+# Default parameter values
+MESSAGE="-- no message provided --"
+# Path to the build directory of the application (relative to the repository root)
+HEADLESS_PATH="./build/release/examples/qt_hpx_opencv/"
+#Below default paths are relative to repository root directory
+LOGS_PATH="./logs/"
+REPO_ROOT_PATH=$(cd ../; pwd)/
+# raw MJPEG file, e.g. made with: ffmpeg -i input.mp4 -s 1920x1080 -q:v 3 -f mjpeg input.mjpg
+MJPEG_FILE=""
+# number of worker threads in the experiments
+THREADS=(2 4 8)
+# frames decoded ahead of the capture in the parallel runs
+READ_AHEAD=8
+# length of every run in seconds
+DURATION=10
+
+POSITIONAL=()
+while [[ $# -gt 0 ]]
+do
+key="$1"
+
+case $key in
+    -mes|--message)
+        MESSAGE="$2"
+        shift # past argument
+        shift # past value
+    ;;
+    -hp|--headless-path)
+        HEADLESS_PATH="$2"
+        shift; shift
+    ;;
+    -lp|--logs-path)
+        LOGS_PATH="$2"
+        shift; shift
+    ;;
+    -f|--file)
+        MJPEG_FILE="$2"
+        shift; shift
+    ;;
+    -r|--read-ahead)
+        READ_AHEAD="$2"
+        shift; shift
+    ;;
+    -d|--duration)
+        DURATION="$2"
+        shift; shift
+    ;;
+    *)    # unknown option
+        POSITIONAL+=("$1") # save it in an array for later
+        shift # past argument
+    ;;
+esac
+done
+set -- "${POSITIONAL[@]}" # restore positional parameters
+
+if [ -z "${MJPEG_FILE}" ]; then
+    echo "ERROR: no MJPEG file given (-f)"
+    exit 1
+fi
+
+### ===========================================================
+###                     FUNCTIONS
+### ===========================================================
+# Turns "[headless] key=value key=value ..." into the table columns
+function headless_line_to_row {
+    local threads=$1
+    local read_ahead=$2
+    local line=$3
+
+    local fields=""
+    for key in frames fps capture_p50_ms glass_to_render_p50_ms glass_to_render_p99_ms; do
+        fields="${fields} $(echo ${line} | sed -n "s/.* ${key}=\([^ ]*\).*/\1/p")"
+    done
+
+    echo "${threads} ${read_ahead}${fields}"
+}
+
+function run_scaling {
+    local table=$1
+
+    cd ${REPO_ROOT_PATH}${HEADLESS_PATH}
+
+    for threads in "${THREADS[@]}"; do
+        for read_ahead in 1 ${READ_AHEAD}; do
+            echo "Executing martycam_headless with threads=${threads} | readahead=${read_ahead}"
+            line=$(./martycam_headless --source="mjpeg://${MJPEG_FILE}?readahead=${read_ahead}&loop=1" \
+                   --fps=1000 --buffer-policy=drop-oldest --duration=${DURATION} \
+                   --hpx:threads=${threads} | grep "^\[headless\]")
+            headless_line_to_row "${threads}" "${read_ahead}" "${line}" >> ${table}
+        done
+    done
+}
+
+### ===========================================================
+###                         MAIN
+### ===========================================================
+
+TIMESTAMP=$(date +"%Y-%m-%d-%H.%M")
+
+LOGS_PATH=${LOGS_PATH}${TIMESTAMP}-decode_scaling/
+mkdir -p ${REPO_ROOT_PATH}${LOGS_PATH}
+TABLE=${REPO_ROOT_PATH}${LOGS_PATH}decode_scaling.txt
+
+echo -e "Executing script: ${0}\n"
+echo "Used parameters:"
+echo "    MESSAGE = ${MESSAGE}"
+echo "    LOGS_PATH = ${LOGS_PATH}"
+echo "    HEADLESS_PATH = ${HEADLESS_PATH}"
+echo "    MJPEG_FILE = ${MJPEG_FILE}"
+echo "    READ_AHEAD = ${READ_AHEAD}"
+echo "    DURATION = ${DURATION}"
+echo -e "    REPO_ROOT_PATH = ${REPO_ROOT_PATH}\n"
+
+echo "threads readahead frames fps capture_p50[ms] latency_p50[ms] latency_p99[ms]" > ${TABLE}
+
+run_scaling ${TABLE}
+
+echo "============================================================================="
+echo "=================        Decode scaling results            =================="
+echo "============================================================================="
+column -t ${TABLE}
@@ -0,0 +1,135 @@
+#/bin/bash
+
+# this script runs martycam_headless with a synthetic source at a set of resolutions and erode/dilate
+# iteration counts, with the iterations computed by the OpenCV calls, by the van Herk/Gil-Werman filter
+# and by both with the results compared, and prints the erode/dilate time per frame, the speedup of the
+# van Herk/Gil-Werman filter and the pixels on which the two differ (which must be 0).
+
+### ===========================================================
+###                        INPUT PARAMETERS
+### ===========================================================
+# Default parameter values
+MESSAGE="-- no message provided --"
+# Path to the build directory of the application (relative to the repository root)
+HEADLESS_PATH="./build/release/examples/qt_hpx_opencv/"
+#Below default paths are relative to repository root directory
+LOGS_PATH="./logs/"
+REPO_ROOT_PATH=$(cd ../; pwd)/
+# frame sizes of the experiments
+RESOLUTIONS=(640x480 1280x720 1920x1080)
+# erode and dilate iterations of the experiments
+ITERATIONS=(1 2 4 8 16)
+# morphology methods, the first one is the reference of the speedup
+METHODS=(opencv vhgw compare)
+# fraction of the image covered by moving shapes
+MOTION=0.05
+# number of worker threads
+THREADS=4
+# length of every run in seconds
+DURATION=10
+
+POSITIONAL=()
+while [[ $# -gt 0 ]]
+do
+key="$1"
+
+case $key in
+    -mes|--message)
+        MESSAGE="$2"
+        shift # past argument
+        shift # past value
+    ;;
+    -hp|--headless-path)
+        HEADLESS_PATH="$2"
+        shift; shift
+    ;;
+    -lp|--logs-path)
+        LOGS_PATH="$2"
+        shift; shift
+    ;;
+    -m|--motion)
+        MOTION="$2"
+        shift; shift
+    ;;
+    -t|--threads)
+        THREADS="$2"
+        shift; shift
+    ;;
+    -d|--duration)
+        DURATION="$2"
+        shift; shift
+    ;;
+    *)    # unknown option
+        POSITIONAL+=("$1") # save it in an array for later
+        shift # past argument
+    ;;
+esac
+done
+set -- "${POSITIONAL[@]}" # restore positional parameters
+
+### ===========================================================
+###                     FUNCTIONS
+### ===========================================================
+# Extracts the value of key from a "[headless] key=value key=value ..." line
+function headless_value {
+    echo $2 | sed -n "s/.* $1=\([^ ]*\).*/\1/p"
+}
+
+function run_study {
+    local table=$1
+
+    cd ${REPO_ROOT_PATH}${HEADLESS_PATH}
+
+    for size in "${RESOLUTIONS[@]}"; do
+        local width=${size%x*}
+        local height=${size#*x}
+        for iterations in "${ITERATIONS[@]}"; do
+            local opencv_ms=""
+            for method in "${METHODS[@]}"; do
+                echo "Executing martycam_headless with size=${size} | erode=${iterations} | dilate=${iterations} | morphology=${method}"
+                line=$(./martycam_headless --source="synthetic://?width=${width}&height=${height}&motion=${MOTION}&noise=4" \
+                       --width=${width} --height=${height} --fps=30 --duration=${DURATION} \
+                       --erode=${iterations} --dilate=${iterations} --morphology=${method} --hpx:threads=${THREADS} | grep "^\[headless\]")
+                ms=$(headless_value morphology_ms "${line}")
+                if [ "${method}" == "${METHODS[0]}" ]; then
+                    opencv_ms=${ms}
+                    speedup="1.00"
+                elif [ "${method}" == "compare" ]; then
+                    speedup="-"
+                else
+                    speedup=$(awk -v a="${opencv_ms}" -v b="${ms}" 'BEGIN { if (b > 0) printf "%.2f", a / b; else print "-" }')
+                fi
+                echo "${size} ${iterations} ${method} $(headless_value frames "${line}") ${ms} $(headless_value processing_p50_ms "${line}") ${speedup} $(headless_value morphology_mismatch_px "${line}")" >> ${table}
+            done
+        done
+    done
+}
+
+### ===========================================================
+###                         MAIN
+### ===========================================================
+
+TIMESTAMP=$(date +"%Y-%m-%d-%H.%M")
+
+LOGS_PATH=${LOGS_PATH}${TIMESTAMP}-morphology/
+mkdir -p ${REPO_ROOT_PATH}${LOGS_PATH}
+TABLE=${REPO_ROOT_PATH}${LOGS_PATH}morphology.txt
+
+echo -e "Executing script: ${0}\n"
+echo "Used parameters:"
+echo "    MESSAGE = ${MESSAGE}"
+echo "    LOGS_PATH = ${LOGS_PATH}"
+echo "    HEADLESS_PATH = ${HEADLESS_PATH}"
+echo "    MOTION = ${MOTION}"
+echo "    THREADS = ${THREADS}"
+echo "    DURATION = ${DURATION}"
+echo -e "    REPO_ROOT_PATH = ${REPO_ROOT_PATH}\n"
+
+echo "size iterations morphology frames erode_dilate[ms] processing_p50[ms] speedup mismatch_px" > ${TABLE}
+
+run_study ${TABLE}
+
+echo "============================================================================="
+echo "=================         Morphology results               =================="
+echo "============================================================================="
+column -t ${TABLE}
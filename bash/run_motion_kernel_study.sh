@@ -0,0 +1,141 @@
+#/bin/bash
+
+# this script runs martycam_headless with a synthetic source at a set of resolutions, with the motion
+# detection computed by one OpenCV call per step, by the fused single pass with the float moving average,
+# by the fused pass with the 16 bit fixed point average, by the same on grey frames only (luma), by
+# the coarse-to-fine pyramid pass and by the fused pass skipping static blocks, and prints the processing
+# time per frame and the speedup over the OpenCV calls. With --blobs 1 every run also labels and
+# tracks the blobs of the motion mask and their time per frame is added to the table.
+
+### ===========================================================
+###                        INPUT PARAMETERS
+### ===========================================================
+# Default parameter values
+MESSAGE="-- no message provided --"
+# Path to the build directory of the application (relative to the repository root)
+HEADLESS_PATH="./build/release/examples/qt_hpx_opencv/"
+#Below default paths are relative to repository root directory
+LOGS_PATH="./logs/"
+REPO_ROOT_PATH=$(cd ../; pwd)/
+# frame sizes of the experiments
+RESOLUTIONS=(640x480 1280x720 1920x1080 3840x2160)
+# motion kernel:background model:luma only:pyramid scale:skip level
+CONFIGURATIONS=(opencv:float:0:0:0 fused:float:0:0:0 fused:fixed16:0:0:0 fused:fixed16:1:0:0
+                opencv:float:0:8:0 fused:fixed16:0:0:2)
+# fraction of the image covered by moving shapes
+MOTION=0.05
+# number of worker threads
+THREADS=4
+# length of every run in seconds
+DURATION=10
+# label and track the blobs of the motion mask
+BLOBS=0
+
+POSITIONAL=()
+while [[ $# -gt 0 ]]
+do
+key="$1"
+
+case $key in
+    -mes|--message)
+        MESSAGE="$2"
+        shift # past argument
+        shift # past value
+    ;;
+    -hp|--headless-path)
+        HEADLESS_PATH="$2"
+        shift; shift
+    ;;
+    -lp|--logs-path)
+        LOGS_PATH="$2"
+        shift; shift
+    ;;
+    -m|--motion)
+        MOTION="$2"
+        shift; shift
+    ;;
+    -t|--threads)
+        THREADS="$2"
+        shift; shift
+    ;;
+    -d|--duration)
+        DURATION="$2"
+        shift; shift
+    ;;
+    -b|--blobs)
+        BLOBS="$2"
+        shift; shift
+    ;;
+    *)    # unknown option
+        POSITIONAL+=("$1") # save it in an array for later
+        shift # past argument
+    ;;
+esac
+done
+set -- "${POSITIONAL[@]}" # restore positional parameters
+
+### ===========================================================
+###                     FUNCTIONS
+### ===========================================================
+# Extracts the value of key from a "[headless] key=value key=value ..." line
+function headless_value {
+    echo $2 | sed -n "s/.* $1=\([^ ]*\).*/\1/p"
+}
+
+function run_study {
+    local table=$1
+
+    cd ${REPO_ROOT_PATH}${HEADLESS_PATH}
+
+    for size in "${RESOLUTIONS[@]}"; do
+        local width=${size%x*}
+        local height=${size#*x}
+        local opencv_p50=""
+        for configuration in "${CONFIGURATIONS[@]}"; do
+            IFS=: read kernel model luma pyramid skip <<< "${configuration}"
+            echo "Executing martycam_headless with size=${size} | motion-kernel=${kernel} | background-model=${model} | motion-luma=${luma} | motion-pyramid=${pyramid} | motion-skip-level=${skip}"
+            line=$(./martycam_headless --source="synthetic://?width=${width}&height=${height}&motion=${MOTION}&noise=4" \
+                   --width=${width} --height=${height} --fps=30 --duration=${DURATION} \
+                   --motion-kernel=${kernel} --background-model=${model} --motion-luma=${luma} --motion-pyramid=${pyramid} --motion-skip-level=${skip} --motion-blobs=${BLOBS} --hpx:threads=${THREADS} | grep "^\[headless\]")
+            p50=$(headless_value processing_p50_ms "${line}")
+            p99=$(headless_value processing_p99_ms "${line}")
+            if [ "${configuration}" == "${CONFIGURATIONS[0]}" ]; then
+                opencv_p50=${p50}
+                speedup="1.00"
+            else
+                speedup=$(awk -v a="${opencv_p50}" -v b="${p50}" 'BEGIN { if (b > 0) printf "%.2f", a / b; else print "-" }')
+            fi
+            echo "${size} ${kernel} ${model} ${luma} ${pyramid} ${skip} $(headless_value frames "${line}") ${p50} ${p99} ${speedup} $(headless_value refined_tiles "${line}") $(headless_value skipped_blocks "${line}") $(headless_value blobs_per_frame "${line}") $(headless_value blob_ms "${line}")" >> ${table}
+        done
+    done
+}
+
+### ===========================================================
+###                         MAIN
+### ===========================================================
+
+TIMESTAMP=$(date +"%Y-%m-%d-%H.%M")
+
+LOGS_PATH=${LOGS_PATH}${TIMESTAMP}-motion_kernel/
+mkdir -p ${REPO_ROOT_PATH}${LOGS_PATH}
+TABLE=${REPO_ROOT_PATH}${LOGS_PATH}motion_kernel.txt
+
+echo -e "Executing script: ${0}\n"
+echo "Used parameters:"
+echo "    MESSAGE = ${MESSAGE}"
+echo "    LOGS_PATH = ${LOGS_PATH}"
+echo "    HEADLESS_PATH = ${HEADLESS_PATH}"
+echo "    MOTION = ${MOTION}"
+echo "    THREADS = ${THREADS}"
+echo "    DURATION = ${DURATION}"
+echo "    BLOBS = ${BLOBS}"
+echo -e "    REPO_ROOT_PATH = ${REPO_ROOT_PATH}\n"
+
+echo "size kernel background luma pyramid skip frames processing_p50[ms] processing_p99[ms] speedup refined_tiles skipped_blocks blobs blob[ms]" > ${TABLE}
+
+run_study ${TABLE}
+
+echo "============================================================================="
+echo "=================        Motion kernel results             =================="
+echo "============================================================================="
+column -t ${TABLE}
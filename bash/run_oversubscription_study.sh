@@ -0,0 +1,130 @@
+#/bin/bash
+
+# this script runs hpx_mandelbrot in blocking-study mode for the three layouts of the blocking pool
+# (dedicated blocking-tp, HPX io-pool and blocking-tp oversubscribed onto the default pool PUs) and a set
+# of blocking workloads, and collects compute degradation and blocking call latency into a single table.
+
+### ===========================================================
+###                        INPUT PARAMETERS
+### ===========================================================
+# Default parameter values
+MESSAGE="-- no message provided --"
+# Path to the build directory of the application (relative to the repository root)
+HPX_MANDELBROT_PATH="./build/release/examples/hpx_mandelbrot/"
+#Below default paths are relative to repository root directory
+LOGS_PATH="./logs/"
+REPO_ROOT_PATH=$(cd ../; pwd)/
+# number of processing units used in the experiment
+NUM_PUS=4
+# size and iterations of the rendered frames
+MB_SIZE=1000
+MB_ITER=500
+# number of frames rendered with and without the blocking workload
+NUM_FRAMES=20
+
+POSITIONAL=()
+while [[ $# -gt 0 ]]
+do
+key="$1"
+
+case $key in
+    -mes|--message)
+        MESSAGE="$2"
+        shift # past argument
+        shift # past value
+    ;;
+    -hm|--hpx-mandelbrot-path)
+        HPX_MANDELBROT_PATH="$2"
+        shift; shift
+    ;;
+    -lp|--logs-path)
+        LOGS_PATH="$2"
+        shift; shift
+    ;;
+    -t|--threads)
+        NUM_PUS="$2"
+        shift; shift
+    ;;
+    -f|--frames)
+        NUM_FRAMES="$2"
+        shift; shift
+    ;;
+    *)    # unknown option
+        POSITIONAL+=("$1") # save it in an array for later
+        shift # past argument
+    ;;
+esac
+done
+set -- "${POSITIONAL[@]}" # restore positional parameters
+
+# layouts of the blocking pool, as hpx_mandelbrot options
+LAYOUTS=("dedicated:--use-io-tp=0 --oversubscription=0"
+         "io-pool:--use-io-tp=1"
+         "oversubscribed:--use-io-tp=0 --oversubscription=1")
+
+# blocking workloads "duty_cycle:call_ms:calls_per_second"
+WORKLOADS=("0.1:5:50" "0.5:5:50" "0.1:1:500" "0.05:20:10")
+
+### ===========================================================
+###                     FUNCTIONS
+### ===========================================================
+# Turns "[blocking-study] key=value key=value ..." into the table columns
+function study_line_to_row {
+    local layout=$1
+    local line=$2
+
+    local fields=""
+    for key in duty_cycle call_ms call_freq baseline_frame_ms loaded_frame_ms degradation \
+               calls call_latency_mean_ms call_latency_p99_ms call_latency_max_ms; do
+        fields="${fields} $(echo ${line} | sed -n "s/.* ${key}=\([^ ]*\).*/\1/p")"
+    done
+
+    echo "${layout}${fields}"
+}
+
+function run_study {
+    local table=$1
+
+    cd ${REPO_ROOT_PATH}${HPX_MANDELBROT_PATH}
+
+    for layout in "${LAYOUTS[@]}"; do
+        IFS=':' read name options <<< "${layout}"
+        for workload in "${WORKLOADS[@]}"; do
+            IFS=':' read duty call_ms freq <<< "${workload}"
+            echo "Executing hpx_mandelbrot with layout=${name} | duty_cycle=${duty} | call_ms=${call_ms} | call_freq=${freq} | num_pus=${NUM_PUS}"
+            line=$(./hpx_mandelbrot ${options} --blocking-study=1 --study-frames=${NUM_FRAMES} \
+                   --blocking-duty-cycle=${duty} --blocking-call-ms=${call_ms} --blocking-call-freq=${freq} \
+                   -s ${MB_SIZE} --mb-iter=${MB_ITER} --hpx:threads=${NUM_PUS} | grep "^\[blocking-study\]")
+            study_line_to_row "${name}" "${line}" >> ${table}
+        done
+    done
+}
+
+### ===========================================================
+###                         MAIN
+### ===========================================================
+
+TIMESTAMP=$(date +"%Y-%m-%d-%H.%M")
+
+LOGS_PATH=${LOGS_PATH}${TIMESTAMP}-oversubscription_study/
+mkdir -p ${REPO_ROOT_PATH}${LOGS_PATH}
+TABLE=${REPO_ROOT_PATH}${LOGS_PATH}oversubscription_study.txt
+
+echo -e "Executing script: ${0}\n"
+echo "Used parameters:"
+echo "    MESSAGE = ${MESSAGE}"
+echo "    LOGS_PATH = ${LOGS_PATH}"
+echo "    HPX_MANDELBROT_PATH = ${HPX_MANDELBROT_PATH}"
+echo "    NUM_PUS = ${NUM_PUS}"
+echo "    NUM_FRAMES = ${NUM_FRAMES}"
+echo -e "    REPO_ROOT_PATH = ${REPO_ROOT_PATH}\n"
+
+echo "layout duty call[ms] calls/s frame[ms] loaded_frame[ms] degradation calls" \
+     "latency_mean[ms] latency_p99[ms] latency_max[ms]" > ${TABLE}
+
+run_study ${TABLE}
+
+echo "============================================================================="
+echo "=================      Oversubscription study results      =================="
+echo "============================================================================="
+column -t ${TABLE}
@@ -0,0 +1,155 @@
+#/bin/bash
+
+# this script runs hpx_mandelbrot and opencv_mandelbrot with every HPX scheduling policy and a set of workload shapes
+# and collects execution time, idle rate and steal count of the default pool into a single table.
+# Note: idle rate and steal counts are reported as -1 unless HPX was built with
+#       -DHPX_WITH_THREAD_IDLE_RATES=ON -DHPX_WITH_THREAD_STEALING_COUNTS=ON
+
+### ===========================================================
+###                        INPUT PARAMETERS
+### ===========================================================
+# Default parameter values
+MESSAGE="-- no message provided --"
+# Paths to the build directories of the applications (relative to the repository root)
+HPX_MANDELBROT_PATH="./build/release/examples/hpx_mandelbrot/"
+OPENCV_MANDELBROT_PATH="./build/release/examples/opencv_mandelbrot/"
+#Below default paths are relative to repository root directory
+LOGS_PATH="./logs/"
+REPO_ROOT_PATH=$(cd ../; pwd)/
+# number of processing units used in the experiment
+NUM_PUS=4
+# number of repetitions of every configuration
+NUM_REPS=3
+
+POSITIONAL=()
+while [[ $# -gt 0 ]]
+do
+key="$1"
+
+case $key in
+    -mes|--message)
+        MESSAGE="$2"
+        shift # past argument
+        shift # past value
+    ;;
+    -hm|--hpx-mandelbrot-path)
+        HPX_MANDELBROT_PATH="$2"
+        shift; shift
+    ;;
+    -om|--opencv-mandelbrot-path)
+        OPENCV_MANDELBROT_PATH="$2"
+        shift; shift
+    ;;
+    -lp|--logs-path)
+        LOGS_PATH="$2"
+        shift; shift
+    ;;
+    -t|--threads)
+        NUM_PUS="$2"
+        shift; shift
+    ;;
+    -r|--repetitions)
+        NUM_REPS="$2"
+        shift; shift
+    ;;
+    *)    # unknown option
+        POSITIONAL+=("$1") # save it in an array for later
+        shift # past argument
+    ;;
+esac
+done
+set -- "${POSITIONAL[@]}" # restore positional parameters
+
+# scheduling policies, named as for the --hpx:queuing option
+POLICIES=(local local-priority-fifo local-priority-lifo static static-priority
+          abp-priority-fifo abp-priority-lifo shared-priority)
+
+# workload shapes "edge_length:max_iterations" - few iterations give a regular
+# workload, many iterations make the cost per pixel very irregular
+HPX_SHAPES=("2000:20" "2000:500" "1000:5000")
+
+# workload shapes "height:width:max_iterations:nstripes"
+OPENCV_SHAPES=("2000:2000:20:-1" "2000:2000:500:-1" "1000:1000:5000:-1" "1000:1000:5000:64")
+
+### ===========================================================
+###                     FUNCTIONS
+### ===========================================================
+# Turns "[scheduler] key=value key=value ..." into the table columns
+function scheduler_line_to_row {
+    local app=$1
+    local policy=$2
+    local shape=$3
+    local line=$4
+
+    local time=$(echo ${line} | sed -n 's/.* time=\([^ ]*\).*/\1/p')
+    local idle_rate=$(echo ${line} | sed -n 's/.* idle_rate=\([^ ]*\).*/\1/p')
+    local stolen=$(echo ${line} | sed -n 's/.* stolen=\([^ ]*\).*/\1/p')
+
+    echo "${app} ${policy} ${shape} ${time} ${idle_rate} ${stolen}"
+}
+
+function run_hpx_mandelbrot_sweep {
+    local table=$1
+
+    cd ${REPO_ROOT_PATH}${HPX_MANDELBROT_PATH}
+
+    for policy in "${POLICIES[@]}"; do
+        for shape in "${HPX_SHAPES[@]}"; do
+            IFS=':' read size iter <<< "${shape}"
+            for ((rep=1; rep<=NUM_REPS; rep++)); do
+                echo "Executing hpx_mandelbrot with policy=${policy} | size=${size} | iter=${iter} | num_pus=${NUM_PUS}"
+                line=$(./hpx_mandelbrot --default-scheduler=${policy} --blocking-scheduler=${policy} \
+                       -s ${size} --mb-iter=${iter} --show-image=0 --hpx:threads=${NUM_PUS} | grep "^\[scheduler\]")
+                scheduler_line_to_row "hpx_mandelbrot" "${policy}" "${size}x${size}/${iter}" "${line}" >> ${table}
+            done
+        done
+    done
+}
+
+function run_opencv_mandelbrot_sweep {
+    local table=$1
+
+    cd ${REPO_ROOT_PATH}${OPENCV_MANDELBROT_PATH}
+
+    for policy in "${POLICIES[@]}"; do
+        for shape in "${OPENCV_SHAPES[@]}"; do
+            IFS=':' read height width iter nstripes <<< "${shape}"
+            for ((rep=1; rep<=NUM_REPS; rep++)); do
+                echo "Executing opencv_mandelbrot with policy=${policy} | height=${height} | width=${width} | iter=${iter} | nstripes=${nstripes} | num_pus=${NUM_PUS}"
+                line=$(./opencv_mandelbrot -h ${height} -w ${width} -i ${iter} -n ${nstripes} -b "hpx" \
+                       --hpx:threads ${NUM_PUS} --hpx:queuing=${policy} --scheduler-stats=1 | grep "^\[scheduler\]")
+                rm -f *.png
+                scheduler_line_to_row "opencv_mandelbrot" "${policy}" "${height}x${width}/${iter}/n${nstripes}" "${line}" >> ${table}
+            done
+        done
+    done
+}
+
+### ===========================================================
+###                         MAIN
+### ===========================================================
+
+TIMESTAMP=$(date +"%Y-%m-%d-%H.%M")
+
+LOGS_PATH=${LOGS_PATH}${TIMESTAMP}-scheduler_sweep/
+mkdir -p ${REPO_ROOT_PATH}${LOGS_PATH}
+TABLE=${REPO_ROOT_PATH}${LOGS_PATH}scheduler_sweep.txt
+
+echo -e "Executing script: ${0}\n"
+echo "Used parameters:"
+echo "    MESSAGE = ${MESSAGE}"
+echo "    LOGS_PATH = ${LOGS_PATH}"
+echo "    HPX_MANDELBROT_PATH = ${HPX_MANDELBROT_PATH}"
+echo "    OPENCV_MANDELBROT_PATH = ${OPENCV_MANDELBROT_PATH}"
+echo "    NUM_PUS = ${NUM_PUS}"
+echo -e "    REPO_ROOT_PATH = ${REPO_ROOT_PATH}\n"
+
+echo "app policy shape time[s] idle_rate[%] stolen" > ${TABLE}
+
+run_hpx_mandelbrot_sweep ${TABLE}
+run_opencv_mandelbrot_sweep ${TABLE}
+
+echo "============================================================================="
+echo "====================      Scheduler sweep results      ======================"
+echo "============================================================================="
+column -t ${TABLE}
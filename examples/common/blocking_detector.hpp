@@ -0,0 +1,353 @@
+#ifndef BLOCKING_DETECTOR_HPP
+#define BLOCKING_DETECTOR_HPP
+
+#include <hpx/include/threads.hpp>
+#include <hpx/runtime/threads/thread_helpers.hpp>
+#include <hpx/util/backtrace.hpp>
+#include <hpx/util/invoke.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <set>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+// Instrumentation for HPX tasks that sit on a worker thread for longer than
+// a threshold without yielding - typically a blocking OS call such as
+// cv::waitKey, VideoCapture::read or a boost/std sleep that ended up on a
+// pool meant for non-blocking work. Such a task stalls its worker and every
+// task queued behind it without any visible signal.
+//
+// Only tasks wrapped with annotate() are watched, and only on the pools
+// which are not ignored: tasks on the blocking pool are expected to block
+// and are left out by passing its name to start(). A watchdog running on a
+// plain OS thread (so it keeps going when the workers stall) polls the
+// phase of every running annotated task: HPX bumps the phase each time a
+// task is resumed, so an active task with an unchanged phase has not
+// yielded since the previous poll. Stalls are counted per pool and task
+// name, together with a backtrace of the place the task was launched from.
+//
+//     blocking_detector::start(50.0, {"blocking"});
+//     hpx::async(exec, blocking_detector::annotate("transform", &transform),
+//         image);
+//     ...
+//     blocking_detector::stop(std::cout);
+namespace blocking_detector {
+
+namespace detail {
+
+    typedef std::chrono::steady_clock clock;
+    typedef std::chrono::duration<double, std::milli> milliseconds;
+
+    struct running_task
+    {
+        hpx::threads::thread_id_type id;
+        std::string name;
+        std::string pool;
+        std::shared_ptr<std::string const> launch_trace;
+        std::size_t phase;
+        clock::time_point since;    // last time the task was seen yielding
+        bool stalled;               // current stall has been counted already
+    };
+
+    struct stall_summary
+    {
+        stall_summary() : count(0), max_ms(0.0), running_at_stop(0) {}
+
+        std::size_t count;
+        double max_ms;
+        std::size_t running_at_stop;
+        std::shared_ptr<std::string const> launch_trace;
+    };
+
+    class detector
+    {
+    public:
+        static detector& instance()
+        {
+            static detector d;
+            return d;
+        }
+
+        bool enabled() const
+        {
+            return enabled_;
+        }
+
+        void start(double threshold_ms, std::set<std::string> ignored_pools)
+        {
+            std::lock_guard<std::mutex> l(mtx_);
+            if (enabled_)
+                return;
+
+            threshold_ = std::chrono::duration_cast<clock::duration>(
+                milliseconds(threshold_ms));
+            ignored_pools_ = std::move(ignored_pools);
+            stop_ = false;
+            enabled_ = true;
+            watchdog_ = std::thread(&detector::watch, this);
+        }
+
+        void stop(std::ostream& os)
+        {
+            {
+                std::lock_guard<std::mutex> l(mtx_);
+                if (!enabled_)
+                    return;
+                enabled_ = false;
+                stop_ = true;
+            }
+            cv_.notify_all();
+            watchdog_.join();
+
+            std::lock_guard<std::mutex> l(mtx_);
+            clock::time_point now = clock::now();
+            for (auto& p : running_)
+            {
+                end_stall(p.second, now);
+                ++summary_for(p.second).running_at_stop;
+            }
+            running_.clear();
+            report(os);
+        }
+
+        // called on the HPX thread when an annotated task starts, returns
+        // false if the task is not watched
+        bool enter(std::string const& name,
+            std::shared_ptr<std::string const> const& launch_trace)
+        {
+            if (!enabled_)
+                return false;
+
+            hpx::threads::thread_id_type id = hpx::threads::get_self_id();
+            if (id == hpx::threads::invalid_thread_id)
+                return false;    // not an HPX thread, e.g. the io-pool
+
+            hpx::error_code ec(hpx::lightweight);
+            hpx::threads::thread_pool_base* pool =
+                hpx::this_thread::get_pool(ec);
+            if (ec || pool == nullptr)
+                return false;
+
+            running_task task;
+            task.id = id;
+            task.name = name;
+            task.pool = pool->get_pool_name();
+            // ignored_pools_ is only written before enabled_ is set
+            if (ignored_pools_.count(task.pool) != 0)
+                return false;
+            task.launch_trace = launch_trace;
+            task.phase = hpx::threads::get_thread_phase(id, ec);
+            task.since = clock::now();
+            task.stalled = false;
+
+            std::lock_guard<std::mutex> l(mtx_);
+            // annotated functions called directly from an annotated task
+            // are accounted to the outermost one
+            return running_.insert(std::make_pair(id.get(), task)).second;
+        }
+
+        void leave()
+        {
+            hpx::threads::thread_id_type id = hpx::threads::get_self_id();
+
+            std::lock_guard<std::mutex> l(mtx_);
+            auto it = running_.find(id.get());
+            if (it == running_.end())
+                return;
+            end_stall(it->second, clock::now());
+            running_.erase(it);
+        }
+
+    private:
+        detector() : enabled_(false), stop_(false) {}
+
+        stall_summary& summary_for(running_task const& task)
+        {
+            stall_summary& s = stalls_[task.pool][task.name];
+            if (!s.launch_trace)
+                s.launch_trace = task.launch_trace;
+            return s;
+        }
+
+        void update_stall(running_task const& task, clock::time_point now)
+        {
+            stall_summary& s = summary_for(task);
+            s.max_ms =
+                (std::max)(s.max_ms, milliseconds(now - task.since).count());
+        }
+
+        void end_stall(running_task& task, clock::time_point now)
+        {
+            if (!task.stalled)
+                return;
+            update_stall(task, now);
+            task.stalled = false;
+        }
+
+        void watch()
+        {
+            std::unique_lock<std::mutex> l(mtx_);
+            while (!stop_)
+            {
+                cv_.wait_for(l, threshold_ / 4);
+
+                clock::time_point now = clock::now();
+                for (auto& p : running_)
+                {
+                    running_task& task = p.second;
+                    hpx::error_code ec(hpx::lightweight);
+
+                    std::size_t phase =
+                        hpx::threads::get_thread_phase(task.id, ec);
+                    hpx::threads::thread_state state =
+                        hpx::threads::get_thread_state(task.id, ec);
+                    if (ec)
+                        continue;
+
+                    // resumed since the last poll or currently suspended
+                    if (phase != task.phase ||
+                        state.state() != hpx::threads::active)
+                    {
+                        end_stall(task, now);
+                        task.phase = phase;
+                        task.since = now;
+                        continue;
+                    }
+
+                    if (!task.stalled && now - task.since > threshold_)
+                    {
+                        task.stalled = true;
+                        ++summary_for(task).count;
+                    }
+                    if (task.stalled)
+                        update_stall(task, now);
+                }
+            }
+        }
+
+        void report(std::ostream& os)
+        {
+            std::size_t total = 0;
+            for (auto const& pool : stalls_)
+                for (auto const& task : pool.second)
+                    total += task.second.count;
+
+            os << "[blocking-detector] threshold="
+               << milliseconds(threshold_).count() << "ms stalls=" << total
+               << "\n";
+            for (auto const& pool : stalls_)
+            {
+                for (auto const& task : pool.second)
+                {
+                    stall_summary const& s = task.second;
+                    if (s.count == 0)
+                        continue;
+                    os << "[blocking-detector] pool=" << pool.first
+                       << " task=" << task.first << " stalls=" << s.count
+                       << " max_stall_ms=" << s.max_ms;
+                    if (s.running_at_stop != 0)
+                        os << " still_running=" << s.running_at_stop;
+                    os << "\n";
+                    if (s.launch_trace && !s.launch_trace->empty())
+                        os << "launched from:\n" << *s.launch_trace << "\n";
+                }
+            }
+        }
+
+        std::atomic<bool> enabled_;
+        bool stop_;
+        clock::duration threshold_;
+        std::set<std::string> ignored_pools_;
+        std::mutex mtx_;
+        std::condition_variable cv_;
+        std::thread watchdog_;
+        std::map<void const*, running_task> running_;
+        std::map<std::string, std::map<std::string, stall_summary>> stalls_;
+    };
+
+    class scoped_task
+    {
+    public:
+        scoped_task(std::string const& name,
+                std::shared_ptr<std::string const> const& launch_trace)
+          : watched_(detector::instance().enter(name, launch_trace))
+        {}
+
+        ~scoped_task()
+        {
+            if (watched_)
+                detector::instance().leave();
+        }
+
+    private:
+        bool watched_;
+    };
+}
+
+// Callable wrapping a task function, registers the running task with the
+// detector for the duration of the call
+template <typename F>
+class annotated_function
+{
+public:
+    annotated_function(std::string name, F f)
+      : name_(std::move(name)), f_(std::move(f))
+    {
+        if (detail::detector::instance().enabled())
+            launch_trace_ =
+                std::make_shared<std::string const>(hpx::util::trace());
+    }
+
+    template <typename... Ts>
+    auto operator()(Ts&&... ts)
+        -> decltype(hpx::util::invoke(std::declval<F&>(),
+            std::forward<Ts>(ts)...))
+    {
+        detail::scoped_task task(name_, launch_trace_);
+        return hpx::util::invoke(f_, std::forward<Ts>(ts)...);
+    }
+
+private:
+    std::string name_;
+    F f_;
+    std::shared_ptr<std::string const> launch_trace_;
+};
+
+template <typename F>
+annotated_function<typename std::decay<F>::type> annotate(
+    std::string name, F&& f)
+{
+    return annotated_function<typename std::decay<F>::type>(
+        std::move(name), std::forward<F>(f));
+}
+
+// Starts the watchdog. Can be called before hpx::init, tasks annotated
+// before start() and tasks running on one of the ignored pools are not
+// watched.
+inline void start(
+    double threshold_ms, std::set<std::string> ignored_pools = {})
+{
+    detail::detector::instance().start(
+        threshold_ms, std::move(ignored_pools));
+}
+
+// Stops the watchdog and prints the stalls per pool and task. Call it after
+// hpx::init has returned to include tasks which are still running when
+// hpx_main finalizes, e.g. a window waiting for a key press.
+inline void stop(std::ostream& os)
+{
+    detail::detector::instance().stop(os);
+}
+}
+
+#endif
@@ -0,0 +1,37 @@
+#ifndef PRIORITY_LANES_HPP
+#define PRIORITY_LANES_HPP
+
+#include <hpx/include/thread_executors.hpp>
+#include <hpx/parallel/executors/pool_executor.hpp>
+
+#include <string>
+
+// Named executors for the classes of work found in the examples:
+//  - frame_critical : work on the path of a frame from capture to display,
+//                     high priority on the compute pool
+//  - normal         : any other compute work, normal priority
+//  - background     : compression of recorded frames, statistics - low
+//                     priority on the compute pool, runs only when no frame
+//                     or normal work is queued
+//  - blocking       : calls which may block the OS thread (camera reads,
+//                     waitKey, file I/O), on the blocking pool
+// The priorities are honoured by the priority schedulers only
+// (local-priority-*, static-priority, abp-priority-*, shared-priority), with
+// the other schedulers every lane runs at normal priority.
+struct priority_lanes
+{
+    explicit priority_lanes(std::string const& compute_pool = "default",
+            std::string const& blocking_pool = "default")
+      : frame_critical(compute_pool, hpx::threads::thread_priority_high),
+        normal(compute_pool),
+        background(compute_pool, hpx::threads::thread_priority_low),
+        blocking(blocking_pool)
+    {}
+
+    hpx::threads::executors::pool_executor frame_critical;
+    hpx::threads::executors::pool_executor normal;
+    hpx::threads::executors::pool_executor background;
+    hpx::threads::executors::pool_executor blocking;
+};
+
+#endif
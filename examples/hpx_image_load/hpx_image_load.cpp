@@ -6,10 +6,21 @@
 #include <hpx/runtime/resource/partitioner.hpp>
 //
 #include <hpx/include/iostreams.hpp>
+#include <hpx/include/apply.hpp>
+#include <hpx/include/threads.hpp>
+#include <hpx/util/high_resolution_timer.hpp>
 //
 #include "system_characteristics.hpp"
+#include "blocking_detector.hpp"
+#include "priority_lanes.hpp"
 //
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
 #include <iostream>
+#include <vector>
 //
 #include <opencv2/opencv.hpp>
 //
@@ -32,6 +43,16 @@ void save_image(const cv::Mat &image, const std::string &);
 
 cv::Mat transform_to_grey(cv::Mat image);
 
+struct background_load;
+void background_task(hpx::threads::executors::pool_executor exec,
+    background_load& load);
+
+std::vector<double> measure_frame_latency(
+    hpx::threads::executors::pool_executor exec, const cv::Mat& image,
+    int num_frames, double frame_ms);
+
+void run_lanes_demo(const cv::Mat& image, int num_frames, double frame_ms);
+
 ///////////////////////////////////////////////////////////////////////////
 /// Global variables
 static bool use_opencv_pool = false;
@@ -86,6 +107,114 @@ void do_stuff(std::size_t n, bool printout) {
         hpx::cout << "\n";
 }
 
+///////////////////////////////////////////////////////////////////////////
+/// Priority lanes demo
+
+// size of a single background task, a few ms of work
+static const std::size_t background_task_size = 200000;
+
+struct background_load
+{
+    background_load() : stop(false), done(0), running(0) {}
+
+    std::atomic<bool> stop;
+    std::atomic<std::size_t> done;       // finished tasks
+    std::atomic<std::size_t> running;    // chains of tasks still alive
+};
+
+// Keeps the lane saturated: every finished task schedules its successor
+// until the load is stopped
+void background_task(hpx::threads::executors::pool_executor exec,
+    background_load& load)
+{
+    do_stuff(background_task_size, false);
+    ++load.done;
+    if (!load.stop)
+        hpx::apply(exec,
+            blocking_detector::annotate("background_task", &background_task),
+            exec, std::ref(load));
+    else
+        --load.running;
+}
+
+// Submits a grey-scale transformation every frame_ms on the given executor
+// and returns the latency from submission to completion of every frame
+std::vector<double> measure_frame_latency(
+    hpx::threads::executors::pool_executor exec, const cv::Mat& image,
+    int num_frames, double frame_ms)
+{
+    std::vector<double> latencies;
+    for (int f = 0; f < num_frames; ++f)
+    {
+        hpx::util::high_resolution_timer timer;
+        hpx::future<cv::Mat> grey = hpx::async(exec,
+            blocking_detector::annotate("transform_to_grey", [&image]() {
+                cv::Mat grey_image;
+                cv::cvtColor(image, grey_image, cv::COLOR_RGB2GRAY);
+                return grey_image;
+            }));
+        grey.get();
+        double latency_ms = timer.elapsed() * 1000.0;
+        latencies.push_back(latency_ms);
+
+        if (latency_ms < frame_ms)
+            hpx::this_thread::sleep_for(std::chrono::microseconds(
+                static_cast<std::int64_t>((frame_ms - latency_ms) * 1000.0)));
+    }
+    std::sort(latencies.begin(), latencies.end());
+    return latencies;
+}
+
+// Compares the frame latency on an idle pool with the latency under a
+// saturating background load, once with all the work at normal priority
+// (as without lanes) and once with the frames on the frame_critical lane
+// and the load on the background lane
+void run_lanes_demo(const cv::Mat& image, int num_frames, double frame_ms)
+{
+    priority_lanes lanes;
+    std::size_t num_background_tasks = 4 * hpx::get_num_worker_threads();
+
+    struct phase
+    {
+        const char* name;
+        hpx::threads::executors::pool_executor frame_exec;
+        hpx::threads::executors::pool_executor load_exec;
+        bool loaded;
+    };
+    std::vector<phase> phases = {
+        {"idle", lanes.frame_critical, lanes.background, false},
+        {"loaded-without-lanes", lanes.normal, lanes.normal, true},
+        {"loaded-with-lanes", lanes.frame_critical, lanes.background, true}};
+
+    for (phase& p : phases)
+    {
+        background_load load;
+        if (p.loaded)
+        {
+            load.running = num_background_tasks;
+            for (std::size_t i = 0; i < num_background_tasks; ++i)
+                hpx::apply(p.load_exec,
+                    blocking_detector::annotate(
+                        "background_task", &background_task),
+                    p.load_exec, std::ref(load));
+        }
+
+        std::vector<double> latencies =
+            measure_frame_latency(p.frame_exec, image, num_frames, frame_ms);
+
+        load.stop = true;
+        while (load.running != 0)
+            hpx::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+        hpx::cout << "[lanes] phase=" << p.name << " frames=" << num_frames
+                  << " latency_p50_ms=" << latencies[latencies.size() / 2]
+                  << " latency_p99_ms="
+                  << latencies[(latencies.size() * 99) / 100]
+                  << " latency_max_ms=" << latencies.back()
+                  << " background_tasks=" << load.done << "\n";
+    }
+}
+
 void print_system_params() {
     // print partition characteristics
     hpx::cout << "\n\n[hpx_main] print resource_partitioner characteristics : "
@@ -116,11 +245,8 @@ int hpx_main(boost::program_options::variables_map& vm)
     std::size_t num_work_threads = hpx::get_num_worker_threads();
     hpx::cout << "HPX using threads = " << num_work_threads << std::endl;
 
-    // create an executor with high priority and normal priority executors for
-    // important tasks
-    hpx::threads::executors::default_executor high_priority_executor(
-        hpx::threads::thread_priority_high_recursive);
-    hpx::threads::executors::default_executor normal_priority_executor;
+    // frame_critical (high priority) and normal lanes of the default pool
+    priority_lanes lanes;
 
     hpx::threads::scheduled_executor opencv_executor;
     // create an executor on the opencv pool
@@ -133,30 +259,39 @@ int hpx_main(boost::program_options::variables_map& vm)
     }
     else
     {
-        opencv_executor = high_priority_executor;
+        opencv_executor = lanes.frame_critical;
     }
 
     print_system_params();
 
     std::string img_path = vm["img-path"].as<std::string>();
 
+    if (vm["lanes-demo"].as<bool>())
+    {
+        run_lanes_demo(load_image(img_path), vm["lanes-frames"].as<int>(),
+            vm["lanes-frame-ms"].as<double>());
+        return hpx::finalize();
+    }
+
 
     // schedule image loading on the opencv pool
-    hpx::future<cv::Mat> f_image = hpx::async(opencv_executor, &load_image,
-            img_path);
+    hpx::future<cv::Mat> f_image = hpx::async(opencv_executor,
+            blocking_detector::annotate("load_image", &load_image), img_path);
 
     cv::Mat image = f_image.get();
 
     cv::Mat grey_image;
     //schedule image processing on the default pool
-    hpx::future<cv::Mat> f_grey_img = hpx::async(normal_priority_executor,
-                                                &transform_to_grey, image);
+    hpx::future<cv::Mat> f_grey_img = hpx::async(lanes.normal,
+            blocking_detector::annotate("transform_to_grey", &transform_to_grey),
+            image);
 
     grey_image = f_grey_img.get();
 
     // schedule image show on the opencv pool
     hpx::future<void> f_imshow_grey = hpx::async(opencv_executor,
-            &show_image, grey_image, "grey_image");
+            blocking_detector::annotate("show_image", &show_image),
+            grey_image, "grey_image");
 
     return hpx::finalize();
 }
@@ -179,7 +314,19 @@ int main(int argc, char* argv[])
         ("use-opencv-pool,u", "Enable advanced HPX thread pools and executors")
         ("opencv_tp_num_threads,m",
           po::value<int>()->default_value(1),
-          "Number of threads to assign to custom pool");
+          "Number of threads to assign to custom pool")
+        ("detect-blocking", po::value<bool>()->default_value(false),
+         "Report tasks which run longer than blocking-threshold-ms without "
+         "yielding, per pool, at shutdown")
+        ("blocking-threshold-ms", po::value<double>()->default_value(50.0),
+         "Threshold used by detect-blocking")
+        ("lanes-demo", po::value<bool>()->default_value(false),
+         "Measure the frame latency under a saturating background load "
+         "with and without the priority lanes")
+        ("lanes-frames", po::value<int>()->default_value(200),
+         "Number of frames measured in every phase of the lanes demo")
+        ("lanes-frame-ms", po::value<double>()->default_value(10.0),
+         "Interval between the frames of the lanes demo in ms");
 
     // HPX uses a boost program options variable map, but we need it before
     // hpx-main, so we will create another one here and throw it away after use
@@ -240,5 +387,12 @@ int main(int argc, char* argv[])
         std::cout << "[main] resources added to thread_pools \n";
     }
 
-    return hpx::init();
+    if (vm["detect-blocking"].as<bool>())
+        blocking_detector::start(
+            vm["blocking-threshold-ms"].as<double>(), {opencv_tp_name});
+
+    int result = hpx::init();
+
+    blocking_detector::stop(std::cout);
+    return result;
 }
\ No newline at end of file
@@ -1,4 +1,7 @@
 #include <hpx/hpx_init.hpp>
+#include <hpx/include/lcos.hpp>
+#include <hpx/include/performance_counters.hpp>
+#include <hpx/util/high_resolution_timer.hpp>
 //
 #include <hpx/parallel/algorithms/for_loop.hpp>
 #include <hpx/parallel/execution.hpp>
@@ -8,14 +11,28 @@
 #include <hpx/include/iostreams.hpp>
 //
 #include "system_characteristics.hpp"
+#include "blocking_detector.hpp"
 //
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <functional>
 #include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
 //
 #include <opencv2/opencv.hpp>
 
 ///////////////////////////////////////////////////////////////////////////
 /// Global Variables (Parameters)
 static const std::string blocking_tp_name("blocking-tp");
+static bool use_numa_pools = false;
+// default pool first, then the pools of the other NUMA domains
+static std::vector<std::string> numa_pool_names(1, "default");
 
 ///////////////////////////////////////////////////////////////////////////
 /// Function Declarations
@@ -26,6 +43,29 @@ void save_image(const cv::Mat& image, const std::string&);
 
 int mandelbrot(const std::complex<float>& z0, const int max);
 int mandelbrotFormula(const std::complex<float>& z0, const int maxIter = 500);
+void render_mandelbrot_rows(cv::Mat& img, int first_row, int last_row,
+    float x1, float y1, float scaleX, float scaleY, int max_iter);
+void render_mandelbrot(cv::Mat& img, float x1, float y1, float scaleX,
+    float scaleY, int max_iter, std::size_t num_work_threads);
+void render_mandelbrot_numa(cv::Mat& img, float x1, float y1, float scaleX,
+    float scaleY, int max_iter, int chunk_rows);
+
+struct blocking_load_params;
+std::vector<double> run_blocking_load(
+    blocking_load_params params, std::atomic<bool>& stop);
+void run_blocking_study(boost::program_options::variables_map& vm,
+    hpx::threads::scheduled_executor blocking_executor, cv::Mat& img,
+    float x1, float y1, float scaleX, float scaleY, int max_iter,
+    std::size_t num_work_threads);
+
+hpx::resource::scheduling_policy parse_scheduling_policy(
+    const std::string& name);
+double query_pool_counter(
+    const std::string& pool_name, const std::string& counter, bool reset);
+
+std::string numa_pool_name(std::size_t domain);
+void add_numa_pools(hpx::resource::partitioner& rp, int num_reserved_pus,
+    hpx::resource::scheduling_policy policy);
 
 void print_system_params();
 
@@ -120,6 +160,397 @@ int mandelbrotFormula(const std::complex<float>& z0, const int maxIter)
     return cvRound(sqrt(value / (float) maxIter) * 255);
 }
 
+void render_mandelbrot_rows(cv::Mat& img, int first_row, int last_row,
+    float x1, float y1, float scaleX, float scaleY, int max_iter)
+{
+    for (int i = first_row; i < last_row; ++i)
+    {
+        uchar* row = img.ptr<uchar>(i);
+        for (int j = 0; j < img.cols; ++j)
+        {
+            std::complex<float> z0(j / scaleX + x1, i / scaleY + y1);
+            row[j] = (uchar) mandelbrotFormula(z0, max_iter);
+        }
+    }
+}
+
+void render_mandelbrot(cv::Mat& img, float x1, float y1, float scaleX,
+    float scaleY, int max_iter, std::size_t num_work_threads)
+{
+    hpx::threads::executors::default_executor default_executor;
+    std::size_t num_pixels = img.rows * img.cols;
+
+    // one iteration per chunk of pixels, so that every chunk is a task
+    // watched by the blocking detector
+    std::size_t chunk = (std::max)(
+        std::size_t(1), (num_pixels / num_work_threads) / 4);
+    std::size_t num_chunks = (num_pixels + chunk - 1) / chunk;
+    auto render_chunk = blocking_detector::annotate("render_mandelbrot",
+        [&](std::size_t c) {
+            std::size_t last = (std::min)((c + 1) * chunk, num_pixels);
+            for (std::size_t r = c * chunk; r != last; ++r)
+            {
+                std::size_t i = r / img.cols;
+                std::size_t j = r % img.cols;
+                float x0 = j / scaleX + x1;
+                float y0 = i / scaleY + y1;
+                std::complex<float> z0(x0, y0);
+                uchar value = (uchar) mandelbrotFormula(z0, max_iter);
+                img.ptr<uchar>(i)[j] = value;
+            }
+        });
+
+    hpx::parallel::execution::static_chunk_size fixed(1);
+    hpx::parallel::for_loop(
+        hpx::parallel::execution::par.with(fixed).on(default_executor),
+        std::size_t(0), num_chunks,
+        [&render_chunk](std::size_t c) { render_chunk(c); });
+}
+
+///////////////////////////////////////////////////////////////////////////
+/// Oversubscription study: synthetic blocking load on the blocking pool
+
+struct blocking_load_params
+{
+    double duty_cycle;        // fraction of every period spent computing
+    double call_ms;           // duration of a single blocking call
+    double call_frequency;    // blocking calls per second
+};
+
+// Runs on the blocking pool until stop is set. Every period of
+// 1/call_frequency seconds starts with duty_cycle * period of computation,
+// followed by one blocking call; the rest of the period the thread waits
+// (blocked) for the next request. Returns the wall time of every blocking
+// call in ms - anything above call_ms is the time the OS thread waited to
+// get its PU back after the call returned.
+std::vector<double> run_blocking_load(
+    blocking_load_params params, std::atomic<bool>& stop)
+{
+    using clock = std::chrono::steady_clock;
+    clock::duration period = std::chrono::duration_cast<clock::duration>(
+        std::chrono::duration<double>(1.0 / params.call_frequency));
+    clock::duration busy = std::chrono::duration_cast<clock::duration>(
+        std::chrono::duration<double>(
+            params.duty_cycle / params.call_frequency));
+    std::chrono::duration<double, std::milli> call(params.call_ms);
+
+    std::vector<double> latencies;
+    clock::time_point next = clock::now();
+    volatile double sink = 0.0;
+    while (!stop)
+    {
+        clock::time_point busy_until = next + busy;
+        for (int i = 1; clock::now() < busy_until; ++i)
+            sink = sink + std::sin(i * 1.0e-3);
+
+        clock::time_point call_start = clock::now();
+        std::this_thread::sleep_for(call);
+        latencies.push_back(std::chrono::duration<double, std::milli>(
+            clock::now() - call_start).count());
+
+        next += period;
+        if (next > clock::now())
+            std::this_thread::sleep_until(next);
+        else
+            next = clock::now();
+    }
+    return latencies;
+}
+
+double percentile(std::vector<double> values, double p)
+{
+    if (values.empty())
+        return 0.0;
+    std::sort(values.begin(), values.end());
+    std::size_t index = static_cast<std::size_t>(p * values.size());
+    return values[(std::min)(index, values.size() - 1)];
+}
+
+// Renders the frames once without and once with the blocking load running
+// on the blocking pool and reports the slowdown of the compute work together
+// with the latency of the blocking calls. Run it once for every layout
+// (dedicated blocking-tp, --use-io-tp and --oversubscription) to compare.
+void run_blocking_study(boost::program_options::variables_map& vm,
+    hpx::threads::scheduled_executor blocking_executor, cv::Mat& img,
+    float x1, float y1, float scaleX, float scaleY, int max_iter,
+    std::size_t num_work_threads)
+{
+    int num_frames = vm["study-frames"].as<int>();
+
+    blocking_load_params params;
+    params.duty_cycle = vm["blocking-duty-cycle"].as<double>();
+    params.call_ms = vm["blocking-call-ms"].as<double>();
+    params.call_frequency = vm["blocking-call-freq"].as<double>();
+
+    std::string layout = "dedicated";
+    if (vm["use-io-tp"].as<bool>())
+        layout = "io-pool";
+    else if (vm["oversubscription"].as<bool>())
+        layout = "oversubscribed";
+
+    hpx::util::high_resolution_timer timer;
+    for (int f = 0; f < num_frames; ++f)
+        render_mandelbrot(
+            img, x1, y1, scaleX, scaleY, max_iter, num_work_threads);
+    double baseline_ms = timer.elapsed() * 1000.0 / num_frames;
+
+    std::atomic<bool> stop(false);
+    hpx::future<std::vector<double>> load = hpx::async(blocking_executor,
+        blocking_detector::annotate("run_blocking_load", &run_blocking_load),
+        params, std::ref(stop));
+
+    timer.restart();
+    for (int f = 0; f < num_frames; ++f)
+        render_mandelbrot(
+            img, x1, y1, scaleX, scaleY, max_iter, num_work_threads);
+    double loaded_ms = timer.elapsed() * 1000.0 / num_frames;
+
+    stop = true;
+    std::vector<double> latencies = load.get();
+
+    double mean = 0.0;
+    for (double l : latencies)
+        mean += l;
+    if (!latencies.empty())
+        mean /= latencies.size();
+
+    // single line summary, parsed by bash/run_oversubscription_study.sh
+    hpx::cout << "[blocking-study] layout=" << layout
+              << " duty_cycle=" << params.duty_cycle
+              << " call_ms=" << params.call_ms
+              << " call_freq=" << params.call_frequency
+              << " frames=" << num_frames
+              << " baseline_frame_ms=" << baseline_ms
+              << " loaded_frame_ms=" << loaded_ms << " degradation="
+              << (baseline_ms > 0.0 ?
+                     100.0 * (loaded_ms - baseline_ms) / baseline_ms : 0.0)
+              << "%"
+              << " calls=" << latencies.size()
+              << " call_latency_mean_ms=" << mean
+              << " call_latency_p99_ms=" << percentile(latencies, 0.99)
+              << " call_latency_max_ms=" << percentile(latencies, 1.0)
+              << "\n";
+}
+
+///////////////////////////////////////////////////////////////////////////
+/// Scheduling policies and scheduler statistics
+
+// Accepts the same names as the --hpx:queuing command line option.
+hpx::resource::scheduling_policy parse_scheduling_policy(
+    const std::string& name)
+{
+    using hpx::resource::scheduling_policy;
+    if (name == "local")
+        return scheduling_policy::local;
+    if (name == "local-priority-fifo")
+        return scheduling_policy::local_priority_fifo;
+    if (name == "local-priority-lifo")
+        return scheduling_policy::local_priority_lifo;
+    if (name == "static")
+        return scheduling_policy::static_;
+    if (name == "static-priority")
+        return scheduling_policy::static_priority;
+    if (name == "abp-priority-fifo")
+        return scheduling_policy::abp_priority_fifo;
+    if (name == "abp-priority-lifo")
+        return scheduling_policy::abp_priority_lifo;
+    if (name == "shared-priority")
+        return scheduling_policy::shared_priority;
+
+    throw std::runtime_error("Unknown scheduling policy: " + name);
+}
+
+// The idle-rate and stealing counters exist only if HPX was built with
+// HPX_WITH_THREAD_IDLE_RATES and HPX_WITH_THREAD_STEALING_COUNTS; -1 is
+// returned otherwise. The idle-rate is reported in units of 0.01%.
+double query_pool_counter(
+    const std::string& pool_name, const std::string& counter, bool reset)
+{
+    std::string name =
+        "/threads{locality#0/pool#" + pool_name + "/total}/" + counter;
+    try
+    {
+        hpx::performance_counters::performance_counter c(name);
+        return c.get_value<double>(hpx::launch::sync, reset);
+    }
+    catch (hpx::exception const&)
+    {
+        return -1.0;
+    }
+}
+
+void reset_pool_counters(const std::string& pool_name)
+{
+    query_pool_counter(pool_name, "idle-rate", true);
+    query_pool_counter(pool_name, "count/stolen-from-pending", true);
+    query_pool_counter(pool_name, "count/stolen-from-staged", true);
+}
+
+///////////////////////////////////////////////////////////////////////////
+/// NUMA mode: one pool per NUMA domain, each owning a band of image rows
+
+// Domain 0 keeps the default pool, every other domain gets its own pool.
+std::string numa_pool_name(std::size_t domain)
+{
+    if (domain == 0)
+        return "default";
+    return "numa-" + std::to_string(domain);
+}
+
+void add_numa_pools(hpx::resource::partitioner& rp, int num_reserved_pus,
+    hpx::resource::scheduling_policy policy)
+{
+    int count = 0;
+    std::size_t domain = 0;
+    for (const hpx::resource::numa_domain& d : rp.numa_domains())
+    {
+        std::vector<hpx::resource::pu> domain_pus;
+        for (const hpx::resource::core& c : d.cores())
+        {
+            for (const hpx::resource::pu& p : c.pus())
+            {
+                // the first PUs are already taken by the blocking pool
+                if (count++ >= num_reserved_pus)
+                    domain_pus.push_back(p);
+            }
+        }
+
+        // a domain whose PUs all went to the blocking pool gets no pool
+        if (domain != 0 && !domain_pus.empty())
+        {
+            std::string pool_name = numa_pool_name(domain);
+            rp.create_thread_pool(pool_name, policy);
+            rp.add_resource(domain_pus, pool_name);
+            numa_pool_names.push_back(pool_name);
+            std::cout << "[main] Created " << pool_name << " thread pool with "
+                      << domain_pus.size() << " PUs of NUMA domain " << domain
+                      << "\n";
+        }
+        ++domain;
+    }
+}
+
+struct numa_band
+{
+    int first_row;
+    int last_row;
+    std::atomic<int> next_row;
+};
+
+struct numa_domain_stats
+{
+    numa_domain_stats()
+      : pixels(0)
+      , local_rows(0)
+      , remote_rows(0)
+      , elapsed(0.0)
+    {
+    }
+
+    std::atomic<std::size_t> pixels;
+    std::atomic<std::size_t> local_rows;
+    std::atomic<std::size_t> remote_rows;
+    double elapsed;
+};
+
+// Every domain first-touches and then renders its own band of rows. Workers
+// of a domain only steal chunks from the bands of other domains after their
+// own band is exhausted; those rows are written across the interconnect and
+// are counted as remote.
+void render_mandelbrot_numa(cv::Mat& img, float x1, float y1, float scaleX,
+    float scaleY, int max_iter, int chunk_rows)
+{
+    std::size_t const num_domains = numa_pool_names.size();
+
+    std::vector<hpx::threads::executors::pool_executor> executors;
+    std::vector<numa_band> bands(num_domains);
+    std::vector<numa_domain_stats> stats(num_domains);
+    for (std::size_t d = 0; d != num_domains; ++d)
+    {
+        executors.emplace_back(numa_pool_names[d]);
+        bands[d].first_row = static_cast<int>(img.rows * d / num_domains);
+        bands[d].last_row = static_cast<int>(img.rows * (d + 1) / num_domains);
+        bands[d].next_row = bands[d].first_row;
+    }
+
+    // The pages of a freshly allocated cv::Mat are not backed by memory
+    // until they are written, so the first write decides on which NUMA
+    // node they end up.
+    std::vector<hpx::future<void>> touched;
+    for (std::size_t d = 0; d != num_domains; ++d)
+    {
+        touched.push_back(hpx::async(executors[d],
+            blocking_detector::annotate("first_touch", [&img, &bands, d]() {
+                uchar* begin = img.data + bands[d].first_row * img.step[0];
+                uchar* end = img.data + bands[d].last_row * img.step[0];
+                std::memset(begin, 0, end - begin);
+            })));
+    }
+    hpx::wait_all(touched);
+
+    hpx::util::high_resolution_timer timer;
+
+    std::vector<hpx::future<double>> workers;
+    std::vector<std::size_t> worker_domain;
+    for (std::size_t d = 0; d != num_domains; ++d)
+    {
+        std::size_t num_threads =
+            hpx::resource::get_num_threads(numa_pool_names[d]);
+        for (std::size_t t = 0; t != num_threads; ++t)
+        {
+            worker_domain.push_back(d);
+            workers.push_back(hpx::async(executors[d],
+                blocking_detector::annotate("render_mandelbrot_numa", [&, d]() {
+                    for (std::size_t k = 0; k != num_domains; ++k)
+                    {
+                        std::size_t owner = (d + k) % num_domains;
+                        numa_band& band = bands[owner];
+                        int row;
+                        while ((row = band.next_row.fetch_add(chunk_rows)) <
+                            band.last_row)
+                        {
+                            int last =
+                                (std::min)(row + chunk_rows, band.last_row);
+                            render_mandelbrot_rows(img, row, last, x1, y1,
+                                scaleX, scaleY, max_iter);
+
+                            std::size_t rows = last - row;
+                            stats[d].pixels += rows * img.cols;
+                            if (owner == d)
+                                stats[d].local_rows += rows;
+                            else
+                                stats[d].remote_rows += rows;
+                        }
+                    }
+                    return timer.elapsed();
+                })));
+        }
+    }
+    hpx::wait_all(workers);
+
+    double total_time = timer.elapsed();
+    for (std::size_t w = 0; w != workers.size(); ++w)
+    {
+        numa_domain_stats& s = stats[worker_domain[w]];
+        s.elapsed = (std::max)(s.elapsed, workers[w].get());
+    }
+
+    hpx::cout << "[numa] Mandelbrot Execution Time: " << total_time << " s\n";
+    for (std::size_t d = 0; d != num_domains; ++d)
+    {
+        numa_domain_stats& s = stats[d];
+        double mpixels = s.pixels / 1.0e6;
+        hpx::cout << "[numa] pool " << numa_pool_names[d] << " ("
+                  << hpx::resource::get_num_threads(numa_pool_names[d])
+                  << " threads): " << mpixels << " Mpixel in " << s.elapsed
+                  << " s = " << (s.elapsed > 0 ? mpixels / s.elapsed : 0.0)
+                  << " Mpixel/s | local rows = " << s.local_rows
+                  << " | remote rows = " << s.remote_rows
+                  << " | remote pixel writes = " << s.remote_rows * img.cols
+                  << "\n";
+    }
+}
+
 ///////////////////////////////////////////////////////////////////////////
 using namespace hpx::threads::policies;
 
@@ -131,8 +562,6 @@ int hpx_main(boost::program_options::variables_map& vm)
     std::size_t num_work_threads = hpx::get_num_worker_threads();
     hpx::cout << "HPX using threads = " << num_work_threads << "\n";
 
-    hpx::threads::executors::default_executor default_executor;
-
     bool use_io_tp = vm["use-io-tp"].as<bool>();
 
     hpx::threads::scheduled_executor blocking_tp_executor;
@@ -147,6 +576,8 @@ int hpx_main(boost::program_options::variables_map& vm)
 
     print_system_params();
 
+    int max_iter = vm["mb-iter"].as<int>();
+
     cv::Mat mandelbrotImg(
         vm["mb-size"].as<int>(), vm["mb-size"].as<int>(), CV_8U);
     float x1 = -2.1f, x2 = 0.6f;
@@ -154,26 +585,49 @@ int hpx_main(boost::program_options::variables_map& vm)
     float scaleX = mandelbrotImg.cols / (x2 - x1);
     float scaleY = mandelbrotImg.rows / (y2 - y1);
 
-    int num_pixels = mandelbrotImg.rows * mandelbrotImg.cols;
-
-    hpx::parallel::execution::static_chunk_size fixed(
-            (num_pixels / num_work_threads) / 4);
-
-    hpx::parallel::for_loop_strided(
-        hpx::parallel::execution::par.with(fixed).on(default_executor), 0,
-        num_pixels, 1, [&](std::size_t r) {
-            std::size_t i = r / mandelbrotImg.cols;
-            std::size_t j = r % mandelbrotImg.cols;
-            float x0 = j / scaleX + x1;
-            float y0 = i / scaleY + y1;
-            std::complex<float> z0(x0, y0);
-            uchar value = (uchar) mandelbrotFormula(z0);
-            mandelbrotImg.ptr<uchar>(i)[j] = value;
-        });
+    if (vm["blocking-study"].as<bool>())
+    {
+        run_blocking_study(vm, blocking_tp_executor, mandelbrotImg, x1, y1,
+            scaleX, scaleY, max_iter, num_work_threads);
+        return hpx::finalize();
+    }
+
+    reset_pool_counters("default");
+    hpx::util::high_resolution_timer timer;
+
+    if (use_numa_pools)
+    {
+        render_mandelbrot_numa(mandelbrotImg, x1, y1, scaleX, scaleY,
+            max_iter, vm["numa-chunk-rows"].as<int>());
+    }
+    else
+    {
+        render_mandelbrot(mandelbrotImg, x1, y1, scaleX, scaleY, max_iter,
+            num_work_threads);
+    }
 
-    hpx::future<void> f_save_image = hpx::async(
-        blocking_tp_executor, &save_image, mandelbrotImg, "mandelbrot.bmp");
-    hpx::async(blocking_tp_executor, &show_image, mandelbrotImg, "Mandelbrot");
+    double elapsed = timer.elapsed();
+    double idle_rate = query_pool_counter("default", "idle-rate", false);
+    double stolen =
+        query_pool_counter("default", "count/stolen-from-pending", false) +
+        query_pool_counter("default", "count/stolen-from-staged", false);
+
+    // single line summary, parsed by bash/run_scheduler_sweep.sh
+    hpx::cout << "[scheduler] default="
+              << vm["default-scheduler"].as<std::string>()
+              << " blocking=" << vm["blocking-scheduler"].as<std::string>()
+              << " size=" << mandelbrotImg.rows << " iter=" << max_iter
+              << " time=" << elapsed
+              << " idle_rate=" << (idle_rate < 0 ? -1.0 : idle_rate / 100.0)
+              << " stolen=" << (stolen < 0 ? -1.0 : stolen) << "\n";
+
+    hpx::future<void> f_save_image = hpx::async(blocking_tp_executor,
+        blocking_detector::annotate("save_image", &save_image), mandelbrotImg,
+        "mandelbrot.bmp");
+    if (vm["show-image"].as<bool>())
+        hpx::async(blocking_tp_executor,
+            blocking_detector::annotate("show_image", &show_image),
+            mandelbrotImg, "Mandelbrot");
 
     return hpx::finalize();
 }
@@ -188,10 +642,43 @@ int main(int argc, char* argv[])
         "Number of threads to assign to custom blocking tp")
         ("mb-size,s", po::value<int>()->default_value(500),
         "Specify the edge length of square mandelbrot image")
+        ("mb-iter", po::value<int>()->default_value(500),
+        "Number of iterations for single pixel of mandelbrot image")
+        ("show-image", po::value<bool>()->default_value(true),
+         "Show the image in a window (blocks until the window is closed)")
+        ("default-scheduler", po::value<std::string>()
+            ->default_value("local-priority-fifo"),
+         "Scheduling policy of the default pool (and the NUMA pools): local, "
+         "local-priority-fifo, local-priority-lifo, static, static-priority, "
+         "abp-priority-fifo, abp-priority-lifo, shared-priority")
+        ("blocking-scheduler", po::value<std::string>()
+            ->default_value("local-priority-fifo"),
+         "Scheduling policy of the blocking pool (same values as above)")
         ("use-io-tp,i", po::value<bool>()->default_value(false),
          "Use io-pool instead of custom blocking thread pool")
         ("oversubscription,o", po::value<bool>()->default_value(false),
-         "Assign all PUs to default and oversubscribe blocking-tp to same PUs");
+         "Assign all PUs to default and oversubscribe blocking-tp to same PUs")
+        ("numa,n", po::value<bool>()->default_value(false),
+         "Create one thread pool per NUMA domain and render domain-local "
+         "row bands")
+        ("numa-chunk-rows", po::value<int>()->default_value(8),
+         "Number of rows taken at once by a worker in NUMA mode")
+        ("blocking-study", po::value<bool>()->default_value(false),
+         "Render frames on the default pool while a synthetic blocking "
+         "workload runs on the blocking pool and report the slowdown")
+        ("study-frames", po::value<int>()->default_value(20),
+         "Number of frames rendered with and without the blocking workload")
+        ("blocking-duty-cycle", po::value<double>()->default_value(0.1),
+         "Fraction of every period the blocking workload spends computing")
+        ("blocking-call-ms", po::value<double>()->default_value(5.0),
+         "Duration of a single blocking call in ms")
+        ("blocking-call-freq", po::value<double>()->default_value(50.0),
+         "Number of blocking calls per second")
+        ("detect-blocking", po::value<bool>()->default_value(false),
+         "Report tasks which run longer than blocking-threshold-ms without "
+         "yielding, per pool, at shutdown")
+        ("blocking-threshold-ms", po::value<double>()->default_value(50.0),
+         "Threshold used by detect-blocking");
 
     // HPX uses a boost program options variable map, but we need it before
     // hpx-main, so we will create another one here and throw it away after use
@@ -211,9 +698,35 @@ int main(int argc, char* argv[])
         return -1;
     }
 
+    // the blocking study averages over the frames and the calls per second
+    if (vm["study-frames"].as<int>() <= 0 ||
+        vm["blocking-call-freq"].as<double>() <= 0.0)
+    {
+        std::cerr << "ERROR: study-frames and blocking-call-freq must be "
+                  << "greater than 0" << "\n" << "\n";
+        std::cerr << desc_cmdline << "\n";
+        return -1;
+    }
+
     int blocking_tp_num_threads = vm["blocking_tp_num_threads"].as<int>();
     bool use_io_pool = vm["use-io-tp"].as<bool>();
     bool use_oversubscription = vm["oversubscription"].as<bool>();
+    use_numa_pools = vm["numa"].as<bool>();
+
+    hpx::resource::scheduling_policy default_policy, blocking_policy;
+    try
+    {
+        default_policy = parse_scheduling_policy(
+            vm["default-scheduler"].as<std::string>());
+        blocking_policy = parse_scheduling_policy(
+            vm["blocking-scheduler"].as<std::string>());
+    }
+    catch (std::runtime_error& e)
+    {
+        std::cerr << "ERROR: " << e.what() << "\n" << "\n";
+        std::cerr << desc_cmdline << "\n";
+        return -1;
+    }
 
     if(!use_io_pool){
         std::cout << "[main] Using custom pool: " << blocking_tp_name
@@ -227,15 +740,21 @@ int main(int argc, char* argv[])
             std::cout << "[main] Obtained reference to the resource_partitioner"
                       << " with oversubscription" << "\n";
 
-            rp.create_thread_pool("default");
-            rp.add_resource(rp.numa_domains(), "default");
+            rp.create_thread_pool("default", default_policy);
+            if (use_numa_pools) {
+                rp.add_resource(rp.numa_domains()[0], "default");
+                add_numa_pools(rp, 0, default_policy);
+
+                std::cout << "[main] Created default thread pool on PUs of "
+                          << "NUMA domain 0" << "\n";
+            } else {
+                rp.add_resource(rp.numa_domains(), "default");
 
-            std::cout << "[main] Created default thread pool on all PUs"
-                      << "\n";;
+                std::cout << "[main] Created default thread pool on all PUs"
+                          << "\n";;
+            }
 
-            rp.create_thread_pool(
-                    blocking_tp_name,
-                    hpx::resource::scheduling_policy::local_priority_fifo);
+            rp.create_thread_pool(blocking_tp_name, blocking_policy);
 
             std::cout << "[main] Created " << blocking_tp_name <<
                          " thread pool." << "\n";;
@@ -251,9 +770,9 @@ int main(int argc, char* argv[])
             std::cout << "[main] Obtained reference to the resource_partitioner"
                       << " without oversubscription" << "\n";
 
-            rp.create_thread_pool(
-                    blocking_tp_name,
-                    hpx::resource::scheduling_policy::local_priority_fifo);
+            rp.create_thread_pool("default", default_policy);
+
+            rp.create_thread_pool(blocking_tp_name, blocking_policy);
 
             std::cout << "[main] Created " << blocking_tp_name <<
                       " thread pool." << "\n";;
@@ -261,10 +780,25 @@ int main(int argc, char* argv[])
             add_pus_to_custom_pool(blocking_tp_name,
                                    blocking_tp_num_threads,
                                    rp);
+
+            if (use_numa_pools)
+                add_numa_pools(rp, blocking_tp_num_threads, default_policy);
         }
     } else {
         std::cout << "[main] Using built-in io-pool" << "\n";
+
+        hpx::resource::partitioner rp(desc_cmdline, argc, argv);
+        rp.create_thread_pool("default", default_policy);
+        if (use_numa_pools)
+            add_numa_pools(rp, 0, default_policy);
     }
 
-    return hpx::init(desc_cmdline, argc, argv);
+    if (vm["detect-blocking"].as<bool>())
+        blocking_detector::start(
+            vm["blocking-threshold-ms"].as<double>(), {blocking_tp_name});
+
+    int result = hpx::init(desc_cmdline, argc, argv);
+
+    blocking_detector::stop(std::cout);
+    return result;
 }
\ No newline at end of file
@@ -11,6 +11,11 @@
 
 #include <hpx/include/runtime.hpp>
 
+#ifndef BACKEND_STARTSTOP
+    #include <hpx/include/performance_counters.hpp>
+    #include <hpx/runtime/get_config_entry.hpp>
+#endif
+
 #include "boost/program_options.hpp"
 
 namespace {
@@ -60,6 +65,27 @@ namespace {
         }
     }
     //! [mandelbrot-sequential]
+
+#ifndef BACKEND_STARTSTOP
+    // The idle-rate and stealing counters exist only if HPX was built with
+    // HPX_WITH_THREAD_IDLE_RATES and HPX_WITH_THREAD_STEALING_COUNTS; -1 is
+    // returned otherwise. The idle-rate is reported in units of 0.01%.
+    double query_pool_counter(
+        const std::string& pool_name, const std::string& counter, bool reset)
+    {
+        std::string name =
+            "/threads{locality#0/pool#" + pool_name + "/total}/" + counter;
+        try
+        {
+            hpx::performance_counters::performance_counter c(name);
+            return c.get_value<double>(hpx::launch::sync, reset);
+        }
+        catch (hpx::exception const&)
+        {
+            return -1.0;
+        }
+    }
+#endif
 }
 
 int main(int argc, char* argv[])
@@ -82,7 +108,10 @@ int main(int argc, char* argv[])
         "Value of OpenCV nstripe parameter enforcing the chunkign on the "
         "backend.")
         ("sequential,s", po::value<bool>()->default_value(false),
-        "Run the mandelbrot sequentially with bypassing parallel backends");
+        "Run the mandelbrot sequentially with bypassing parallel backends")
+        ("scheduler-stats", po::value<bool>()->default_value(false),
+        "Print a [scheduler] line with the scheduling policy (set with "
+        "--hpx:queuing), idle rate and steal count of the default pool");
 
     po::variables_map vm;
     try
@@ -107,6 +136,7 @@ int main(int argc, char* argv[])
     int mandelbrotMaxIter = vm["mandelbrot_iter"].as<int>();
     double nstripes = vm["nstripes"].as<double>();
     bool sequential = vm["sequential"].as<bool>();
+    bool scheduler_stats = vm["scheduler-stats"].as<bool>();
 
 #ifndef BACKEND_STARTSTOP
     int num_threads = hpx::get_num_worker_threads();
@@ -141,6 +171,15 @@ int main(int argc, char* argv[])
     {
         cv::setNumThreads(num_threads);
 
+#ifndef BACKEND_STARTSTOP
+        if (scheduler_stats)
+        {
+            query_pool_counter("default", "idle-rate", true);
+            query_pool_counter("default", "count/stolen-from-pending", true);
+            query_pool_counter("default", "count/stolen-from-staged", true);
+        }
+#endif
+
         double t1 = (double) cv::getTickCount();
         cv::parallel_for_(cv::Range(0, mandelbrotImg.rows * mandelbrotImg.cols),
             [&](const cv::Range& range) {
@@ -163,6 +202,30 @@ int main(int argc, char* argv[])
         t1 = ((double) cv::getTickCount() - t1) / cv::getTickFrequency();
         std::cout << "Parallel Mandelbrot Execution Time: " << t1 << " s"
                   << std::endl;
+
+#ifndef BACKEND_STARTSTOP
+        if (scheduler_stats)
+        {
+            double idle_rate =
+                query_pool_counter("default", "idle-rate", false);
+            double stolen =
+                query_pool_counter(
+                    "default", "count/stolen-from-pending", false) +
+                query_pool_counter(
+                    "default", "count/stolen-from-staged", false);
+
+            // single line summary, parsed by bash/run_scheduler_sweep.sh
+            std::cout << "[scheduler] default="
+                      << hpx::get_config_entry("hpx.scheduler",
+                             "local-priority-fifo")
+                      << " size=" << mandelbrotHeight << "x"
+                      << mandelbrotWidth << " iter=" << mandelbrotMaxIter
+                      << " time=" << t1 << " idle_rate="
+                      << (idle_rate < 0 ? -1.0 : idle_rate / 100.0)
+                      << " stolen=" << (stolen < 0 ? -1.0 : stolen)
+                      << std::endl;
+        }
+#endif
     }
 
     std::string im_name("Mandelbrot_h" + std::to_string(mandelbrotHeight) +
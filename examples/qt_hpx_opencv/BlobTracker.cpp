@@ -0,0 +1,271 @@
+#include "BlobTracker.hpp"
+//
+#include <opencv2/core/core.hpp>
+//
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <tuple>
+
+//----------------------------------------------------------------------------
+// union-find over run indices, the root is the smallest index of the set
+static int findRoot(std::vector<int> &parent, int i)
+{
+  while (parent[i] != i) {
+    parent[i] = parent[parent[i]];
+    i = parent[i];
+  }
+  return i;
+}
+//----------------------------------------------------------------------------
+static void unite(std::vector<int> &parent, int a, int b)
+{
+  a = findRoot(parent, a);
+  b = findRoot(parent, b);
+  if (a < b) parent[b] = a;
+  else if (b < a) parent[a] = b;
+}
+//----------------------------------------------------------------------------
+// Joins the runs of two consecutive rows which touch, also diagonally.
+// above and below are index ranges into runs, sorted by start.
+static void uniteRows(const std::vector<BlobTracker::Run> &runsAbove, int a, int aEnd,
+                      const std::vector<BlobTracker::Run> &runsBelow, int b, int bEnd,
+                      int offsetAbove, int offsetBelow, std::vector<int> &parent)
+{
+  while (a < aEnd && b < bEnd) {
+    const BlobTracker::Run &up = runsAbove[a];
+    const BlobTracker::Run &down = runsBelow[b];
+    if (up.start <= down.end && up.end >= down.start) {
+      unite(parent, offsetAbove + a, offsetBelow + b);
+    }
+    // the run ending first cannot touch the next one of the other row
+    if (up.end < down.end) a++;
+    else b++;
+  }
+}
+//----------------------------------------------------------------------------
+// Finds the runs of one stripe of rows and joins them with the stripe's own
+// union-find, indices local to the stripe
+class StripeLabelBody : public cv::ParallelLoopBody {
+public:
+  StripeLabelBody(const cv::Mat &mask, int stripeRows,
+                  std::vector<std::vector<BlobTracker::Run>> &runs,
+                  std::vector<std::vector<int>> &parents)
+    : mask(mask), stripeRows(stripeRows), runs(runs), parents(parents) {}
+
+  void operator()(const cv::Range &range) const override
+  {
+    int width = this->mask.cols;
+    for (int stripe = range.start; stripe < range.end; stripe++) {
+      std::vector<BlobTracker::Run> &runs = this->runs[stripe];
+      std::vector<int> &parent = this->parents[stripe];
+      runs.clear();
+      parent.clear();
+      int y0 = stripe*this->stripeRows;
+      int y1 = std::min(y0 + this->stripeRows, this->mask.rows);
+      int above = 0, aboveEnd = 0;
+      for (int y = y0; y < y1; y++) {
+        const uchar *row = this->mask.ptr<uchar>(y);
+        int first = static_cast<int>(runs.size());
+        int x = 0;
+        while (x < width) {
+          // the mask is mostly empty, skip 8 zero pixels at a time
+          uint64_t word;
+          while (x + 8 <= width && (std::memcpy(&word, row + x, 8), word == 0)) {
+            x += 8;
+          }
+          while (x < width && !row[x]) x++;
+          if (x >= width) break;
+          int start = x;
+          while (x < width && row[x]) x++;
+          parent.push_back(static_cast<int>(runs.size()));
+          runs.push_back({y, start, x});
+        }
+        int last = static_cast<int>(runs.size());
+        if (y > y0) {
+          uniteRows(runs, above, aboveEnd, runs, first, last, 0, 0, parent);
+        }
+        above = first;
+        aboveEnd = last;
+      }
+    }
+  }
+
+private:
+  const cv::Mat                               &mask;
+  int                                          stripeRows;
+  std::vector<std::vector<BlobTracker::Run>> &runs;
+  std::vector<std::vector<int>>               &parents;
+};
+//----------------------------------------------------------------------------
+BlobTracker::BlobTracker()
+{
+  this->minArea     = 20;
+  this->maxDistance = 64.0;
+  this->maxMissed   = 5;
+  this->frames      = 0;
+  this->blobsTotal  = 0;
+  this->time_ms     = 0.0;
+  this->nextId      = 1;
+}
+//----------------------------------------------------------------------------
+void BlobTracker::reset()
+{
+  this->blobs.clear();
+  this->tracks.clear();
+  this->nextId = 1;
+}
+//----------------------------------------------------------------------------
+const std::vector<Blob> &BlobTracker::process(const cv::Mat &mask)
+{
+  CV_Assert(mask.type() == CV_8UC1);
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  std::vector<Blob> components;
+  this->label(mask, components);
+  this->track(components);
+  this->frames++;
+  this->blobsTotal += this->blobs.size();
+  this->time_ms += std::chrono::duration<double, std::milli>(
+          std::chrono::steady_clock::now() - start).count();
+  return this->blobs;
+}
+//----------------------------------------------------------------------------
+void BlobTracker::label(const cv::Mat &mask, std::vector<Blob> &components)
+{
+  components.clear();
+  if (mask.empty()) return;
+  // a couple of stripes per thread, at least 32 rows each
+  int stripes = std::max(1, std::min(mask.rows/32, 2*cv::getNumThreads()));
+  int stripeRows = (mask.rows + stripes - 1)/stripes;
+  stripes = (mask.rows + stripeRows - 1)/stripeRows;
+  this->stripeRuns.resize(stripes);
+  this->stripeParents.resize(stripes);
+  StripeLabelBody body(mask, stripeRows, this->stripeRuns, this->stripeParents);
+  cv::parallel_for_(cv::Range(0, stripes), body, stripes);
+
+  // merge pass: stripe local sets into one index space, then join the runs
+  // across each stripe border
+  std::vector<int> offsets(stripes + 1, 0);
+  for (int s = 0; s < stripes; s++) {
+    offsets[s + 1] = offsets[s] + static_cast<int>(this->stripeRuns[s].size());
+  }
+  this->parent.resize(offsets[stripes]);
+  for (int s = 0; s < stripes; s++) {
+    const std::vector<int> &local = this->stripeParents[s];
+    for (std::size_t i = 0; i < local.size(); i++) {
+      this->parent[offsets[s] + i] = offsets[s] + local[i];
+    }
+  }
+  for (int s = 1; s < stripes; s++) {
+    const std::vector<Run> &above = this->stripeRuns[s - 1];
+    const std::vector<Run> &below = this->stripeRuns[s];
+    int border = s*stripeRows;
+    int aboveStart = static_cast<int>(above.size());
+    while (aboveStart > 0 && above[aboveStart - 1].y == border - 1) aboveStart--;
+    int belowEnd = 0;
+    while (belowEnd < static_cast<int>(below.size()) && below[belowEnd].y == border) belowEnd++;
+    uniteRows(above, aboveStart, static_cast<int>(above.size()), below, 0, belowEnd,
+              offsets[s - 1], offsets[s], this->parent);
+  }
+
+  // bounding box, area and centroid of each set, summed over its runs
+  struct Moments {
+    int     x0, y0, x1, y1;
+    int     area;
+    int64_t sumX, sumY;
+  };
+  std::vector<int> component(offsets[stripes], -1);
+  std::vector<Moments> moments;
+  for (int s = 0; s < stripes; s++) {
+    const std::vector<Run> &runs = this->stripeRuns[s];
+    for (std::size_t i = 0; i < runs.size(); i++) {
+      const Run &run = runs[i];
+      int root = findRoot(this->parent, offsets[s] + static_cast<int>(i));
+      if (component[root] < 0) {
+        component[root] = static_cast<int>(moments.size());
+        moments.push_back({run.start, run.y, run.end, run.y + 1, 0, 0, 0});
+      }
+      Moments &m = moments[component[root]];
+      int length = run.end - run.start;
+      m.x0 = std::min(m.x0, run.start);
+      m.x1 = std::max(m.x1, run.end);
+      m.y1 = run.y + 1;
+      m.area += length;
+      m.sumX += static_cast<int64_t>(run.start + run.end - 1)*length/2;
+      m.sumY += static_cast<int64_t>(run.y)*length;
+    }
+  }
+  for (const Moments &m : moments) {
+    if (m.area < this->minArea) continue;
+    Blob blob;
+    blob.id       = 0;
+    blob.box      = cv::Rect(m.x0, m.y0, m.x1 - m.x0, m.y1 - m.y0);
+    blob.area     = m.area;
+    blob.centroid = cv::Point2f(static_cast<float>(m.sumX)/m.area,
+                                static_cast<float>(m.sumY)/m.area);
+    blob.velocity = cv::Point2f(0, 0);
+    blob.age      = 0;
+    components.push_back(blob);
+  }
+}
+//----------------------------------------------------------------------------
+void BlobTracker::track(const std::vector<Blob> &components)
+{
+  // all pairs of track and component closer than maxDistance to where the
+  // track is expected, nearest first
+  std::vector<std::tuple<float, int, int>> pairs;
+  for (std::size_t t = 0; t < this->tracks.size(); t++) {
+    const Blob &last = this->tracks[t].blob;
+    cv::Point2f expected = last.centroid + last.velocity*(this->tracks[t].missed + 1);
+    for (std::size_t c = 0; c < components.size(); c++) {
+      cv::Point2f d = components[c].centroid - expected;
+      float distance = std::sqrt(d.dot(d));
+      if (distance <= this->maxDistance) {
+        pairs.emplace_back(distance, static_cast<int>(t), static_cast<int>(c));
+      }
+    }
+  }
+  std::sort(pairs.begin(), pairs.end());
+
+  std::vector<int> matchedTrack(this->tracks.size(), -1);
+  std::vector<uchar> matchedComponent(components.size(), 0);
+  for (const std::tuple<float, int, int> &pair : pairs) {
+    int t = std::get<1>(pair), c = std::get<2>(pair);
+    if (matchedTrack[t] >= 0 || matchedComponent[c]) continue;
+    matchedTrack[t] = c;
+    matchedComponent[c] = 1;
+  }
+
+  this->blobs.clear();
+  std::vector<Track> next;
+  next.reserve(this->tracks.size() + components.size());
+  for (std::size_t t = 0; t < this->tracks.size(); t++) {
+    Track track = this->tracks[t];
+    if (matchedTrack[t] >= 0) {
+      const Blob &seen = components[matchedTrack[t]];
+      cv::Point2f step = (seen.centroid - track.blob.centroid)*(1.0f/(track.missed + 1));
+      Blob blob     = seen;
+      blob.id       = track.blob.id;
+      blob.velocity = track.blob.age > 0 ? 0.5f*track.blob.velocity + 0.5f*step : step;
+      blob.age      = track.blob.age + 1;
+      track.blob    = blob;
+      track.missed  = 0;
+      this->blobs.push_back(blob);
+    }
+    else if (++track.missed > this->maxMissed) {
+      continue;
+    }
+    next.push_back(track);
+  }
+  for (std::size_t c = 0; c < components.size(); c++) {
+    if (matchedComponent[c]) continue;
+    Track track;
+    track.blob    = components[c];
+    track.blob.id = this->nextId++;
+    track.missed  = 0;
+    next.push_back(track);
+    this->blobs.push_back(track.blob);
+  }
+  this->tracks.swap(next);
+}
@@ -0,0 +1,78 @@
+#ifndef BLOBTRACKER_H
+#define BLOBTRACKER_H
+
+#include "opencv2/core/core.hpp"
+//
+#include <cstdint>
+#include <vector>
+
+//
+// One connected region of the motion mask, matched to the regions of the
+// previous frames
+//
+struct Blob {
+  int         id;         // track number, the same while the object is followed
+  cv::Rect    box;
+  int         area;       // pixels of the mask
+  cv::Point2f centroid;
+  cv::Point2f velocity;   // pixels per frame, smoothed
+  int         age;        // frames since the track started
+};
+
+//
+// Labels the 8-connected components of a binary mask and follows them from
+// frame to frame.
+//
+// The labelling works on runs of non zero pixels. The mask is cut into
+// stripes of rows which cv::parallel_for_ labels independently (union-find
+// over the runs of the stripe), a serial merge pass then joins the runs on
+// both sides of each stripe border and the bounding box, area and centroid
+// of every component are summed from its runs. No label image is written.
+//
+// The tracker matches the components to the tracks of the last frame,
+// nearest predicted centroid first, within maxDistance; unmatched components
+// start new tracks and a track is dropped after maxMissed frames without one.
+//
+class BlobTracker {
+public:
+  BlobTracker();
+
+  // labels mask (CV_8UC1) and updates the tracks, returns the blobs of this frame
+  const std::vector<Blob> &process(const cv::Mat &mask);
+  void reset();
+
+  // smaller components are noise and ignored
+  int     minArea;
+  double  maxDistance;
+  int     maxMissed;
+
+  // output, the tracks seen in the last frame
+  std::vector<Blob> blobs;
+  // statistics
+  int64_t frames;
+  int64_t blobsTotal;
+  double  time_ms;       // labelling and tracking, all frames
+
+  // one run of non zero pixels, x in [start, end)
+  struct Run {
+    int y;
+    int start;
+    int end;
+  };
+
+private:
+  struct Track {
+    Blob blob;
+    int  missed;
+  };
+  void label(const cv::Mat &mask, std::vector<Blob> &components);
+  void track(const std::vector<Blob> &components);
+
+  std::vector<std::vector<Run>> stripeRuns;
+  std::vector<std::vector<int>> stripeParents;
+  std::vector<int>              parent;
+  std::vector<Track>            tracks;
+  int                           nextId;
+};
+
+#endif
@@ -0,0 +1,134 @@
+#include "CameraChain.hpp"
+#include "filter.hpp"
+//
+#include <hpx/include/async.hpp>
+#include <hpx/include/iostreams.hpp>
+#include <hpx/include/threads.hpp>
+//
+#include <boost/make_shared.hpp>
+//
+#include <chrono>
+#include <string>
+
+//----------------------------------------------------------------------------
+void LatencySamples::add(const Frame &frame, clock::time_point rendered)
+{
+  auto ms = [](clock::duration d) {
+    return std::chrono::duration<double, std::milli>(d).count();
+  };
+  std::lock_guard<mutex_type> lk(this->mtx);
+  // gaps in the sequence are frames dropped on the way
+  bool consecutive = this->seen > 0 && frame.sequence == this->lastSequence + 1;
+  if (this->seen > 0 && frame.sequence > this->lastSequence + 1)
+    this->lost += frame.sequence - this->lastSequence - 1;
+  this->lastSequence = frame.sequence;
+  clock::time_point previousCapture = this->lastCapture;
+  this->lastCapture = frame.captureTime;
+  if (++this->seen <= static_cast<std::uint64_t>(this->warmup))
+    return;
+  // pacing of the capture, only between frames which both arrived
+  if (consecutive)
+    this->captureInterval.push_back(ms(frame.captureTime - previousCapture));
+  if (this->glassToRender.empty())
+    this->first = rendered;
+  this->last = rendered;
+  this->glassToRender.push_back(ms(rendered - frame.captureTime));
+  this->captureStage.push_back(ms(frame.queuedTime - frame.captureTime));
+  this->queueWait.push_back(ms(frame.receivedTime - frame.queuedTime));
+  this->processing.push_back(ms(rendered - frame.receivedTime));
+}
+//----------------------------------------------------------------------------
+std::size_t LatencySamples::measured()
+{
+  std::lock_guard<mutex_type> lk(this->mtx);
+  return this->glassToRender.size();
+}
+//----------------------------------------------------------------------------
+CameraChain::CameraChain(int index, const CameraChainParams &params,
+                         const priority_lanes &lanes, Filter *renderer)
+  : index(index), params(params), lanes(lanes), samples(params.warmup), running(false)
+{
+  const PipelineParams &pp = this->params.pipeline;
+  this->imageBuffer = ImageBuffer(new ConcurrentRingBuffer<Frame>(pp.bufferCapacity, pp.bufferPolicy));
+  if (pp.dataflowPipeline) {
+    this->framePipeline = boost::make_shared<FramePipeline>(this->lanes, pp.framesInFlight);
+  }
+  //
+  this->processingThread = boost::make_shared<ProcessingThread>(this->imageBuffer,
+          this->lanes.frame_critical, this->params.processing,
+          this->params.motionFilter, this->params.faceRecogFilter);
+  this->processingThread->setRootFilter(renderer);
+  this->processingThread->setPipelineParams(pp);
+  LatencySamples &samples = this->samples;
+  this->processingThread->setFrameObserver(
+          [&samples](const Frame &frame, Frame::clock::time_point rendered) {
+            samples.add(frame, rendered);
+          });
+  //
+  this->captureThread = boost::make_shared<CaptureThread>(this->imageBuffer,
+          this->params.size, this->params.rotation, 0, this->params.source,
+          this->lanes.blocking, this->lanes.blocking, this->lanes.frame_critical,
+          this->params.fps);
+  if (pp.eventRecording.enabled) {
+    // the clips of each camera get their own names
+    EventRecorderParams erp = pp.eventRecording;
+    erp.prefix += "camera" + std::to_string(this->index) + "-";
+    this->eventRecorder = boost::make_shared<EventRecorder>(erp, this->lanes);
+    this->captureThread->setEventRecorder(this->eventRecorder);
+    this->processingThread->setEventRecorder(this->eventRecorder);
+  }
+  if (!this->captureThread->isRequestedSizeCorrect()) {
+    hpx::cout << "[camera " << this->index << "] warning: " << this->params.source
+              << " does not support " << this->params.size.width << "x"
+              << this->params.size.height << "\n" << hpx::flush;
+  }
+}
+//----------------------------------------------------------------------------
+CameraChain::~CameraChain()
+{
+  if (this->running) {
+    this->stop();
+  }
+}
+//----------------------------------------------------------------------------
+void CameraChain::start()
+{
+  if (this->framePipeline) {
+    this->framePipeline->setProcessingThread(this->processingThread);
+    this->framePipeline->setCaptureThread(this->captureThread);
+  }
+  else {
+    this->processingThread->startProcessing();
+  }
+  this->captureThread->startCapture();
+  this->running = true;
+}
+//----------------------------------------------------------------------------
+void CameraChain::stop()
+{
+  this->captureThread->stopCapture();
+  if (this->framePipeline) {
+    // frames may still be in flight when the source ended by itself
+    while (this->framePipeline->getFramesInFlight() > 0) {
+      hpx::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    this->framePipeline->setCaptureThread(nullptr);
+    this->framePipeline->setProcessingThread(nullptr);
+  }
+  else {
+    // the processing may wait on the empty buffer, wake it until it stopped.
+    // A full buffer needs no wakeup, and send() would block a block-producer
+    // buffer until the processing took a frame
+    ProcessingThread_SP processing = this->processingThread;
+    hpx::future<bool> stopped = hpx::async(this->lanes.normal,
+            [processing]() { return processing->stopProcessing(); });
+    while (!stopped.is_ready()) {
+      this->imageBuffer->try_send(Frame());
+      hpx::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+  }
+  if (this->eventRecorder) {
+    this->eventRecorder->finish();
+  }
+  this->running = false;
+}
@@ -0,0 +1,115 @@
+#ifndef CAMERA_CHAIN_H
+#define CAMERA_CHAIN_H
+
+#include <hpx/config.hpp>
+#include <hpx/lcos/local/mutex.hpp>
+//
+#include <opencv2/core/core.hpp>
+//
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+//
+#include "capturethread.hpp"
+#include "processingthread.hpp"
+#include "EventRecorder.hpp"
+#include "FramePipeline.hpp"
+#include "PipelineParams.hpp"
+#include "Frame.hpp"
+#include "priority_lanes.hpp"
+//
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class Filter;
+class CameraChain;
+typedef boost::shared_ptr<CameraChain> CameraChain_SP;
+
+//
+// Per frame latencies in milliseconds of one camera, collected by the frame
+// observer of its processing
+//
+struct LatencySamples {
+  typedef Frame::clock clock;
+  // the observer runs on HPX threads, which must not block their worker
+  typedef hpx::lcos::local::mutex mutex_type;
+
+  explicit LatencySamples(int warmup) : warmup(warmup), seen(0), lost(0), lastSequence(0) {}
+
+  void add(const Frame &frame, clock::time_point rendered);
+  std::size_t measured();
+
+  int                 warmup;           // frames rendered before the measurement starts
+  mutex_type          mtx;
+  std::uint64_t       seen;
+  std::uint64_t       lost;
+  std::uint64_t       lastSequence;
+  clock::time_point   first;
+  clock::time_point   last;
+  clock::time_point   lastCapture;
+  std::vector<double> glassToRender;   // capture to rendered
+  std::vector<double> captureStage;    // rotation, deinterlacing, recording
+  std::vector<double> queueWait;       // waiting for the processing
+  std::vector<double> processing;      // filtering and rendering
+  std::vector<double> captureInterval; // between consecutive captured frames
+};
+
+//
+// Settings of one camera
+//
+struct CameraChainParams {
+  std::string           source;
+  cv::Size              size;
+  int                   rotation;
+  int                   fps;
+  int                   warmup;
+  ProcessingType        processing;
+  PipelineParams        pipeline;
+  MotionFilterParams    motionFilter;
+  FaceRecogFilterParams faceRecogFilter;
+};
+
+//
+// One camera: its capture, buffer (or dataflow pipeline), filters and
+// latency statistics. Nothing is shared between chains except the pools of
+// the priority lanes and the FramePool, so any number of cameras can run in
+// one process: the grabs of all of them on the blocking pool, the rest on
+// the default pool.
+//
+class CameraChain : private boost::noncopyable
+{
+public:
+  CameraChain(int index, const CameraChainParams &params, const priority_lanes &lanes,
+              Filter *renderer);
+  ~CameraChain();
+
+  void start();
+  // stops the capture and waits until the processing of its frames is done,
+  // called from an HPX thread
+  void stop();
+
+  bool isCapturing() { return this->captureThread->isCapturing(); }
+  int  getIndex() { return this->index; }
+  const CameraChainParams &getParams() { return this->params; }
+  CaptureThread_SP getCaptureThread() { return this->captureThread; }
+  ProcessingThread_SP getProcessingThread() { return this->processingThread; }
+  // null unless the pipeline records events
+  EventRecorder_SP getEventRecorder() { return this->eventRecorder; }
+  LatencySamples &getSamples() { return this->samples; }
+
+private:
+  int                 index;
+  CameraChainParams   params;
+  priority_lanes      lanes;
+  ImageBuffer         imageBuffer;
+  FramePipeline_SP    framePipeline;
+  CaptureThread_SP    captureThread;
+  ProcessingThread_SP processingThread;
+  EventRecorder_SP    eventRecorder;
+  LatencySamples      samples;
+  bool                running;
+};
+
+#endif
@@ -0,0 +1,286 @@
+#ifndef CONCURRENT_RING_BUFFER_H
+#define CONCURRENT_RING_BUFFER_H
+
+#include <hpx/config.hpp>
+#include <hpx/lcos/local/condition_variable.hpp>
+#include <hpx/lcos/local/mutex.hpp>
+//
+#include <boost/noncopyable.hpp>
+//
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+
+// What send() does when the buffer is full
+enum class BufferPolicy: int
+{
+    blockProducer = 0,  // suspend the sender until there is room
+    dropOldest    = 1,  // overwrite the oldest element
+    dropNewest    = 2,  // discard the element being sent
+    latestOnly    = 3,  // single slot mailbox, overwritten by every send
+};
+
+inline bool parseBufferPolicy(const std::string &name, BufferPolicy &policy) {
+  if (name == "block-producer") policy = BufferPolicy::blockProducer;
+  else if (name == "drop-oldest") policy = BufferPolicy::dropOldest;
+  else if (name == "drop-newest") policy = BufferPolicy::dropNewest;
+  else if (name == "latest-only") policy = BufferPolicy::latestOnly;
+  else return false;
+  return true;
+}
+
+inline const char *bufferPolicyName(BufferPolicy policy) {
+  switch (policy) {
+    case BufferPolicy::blockProducer: return "block-producer";
+    case BufferPolicy::dropOldest:    return "drop-oldest";
+    case BufferPolicy::dropNewest:    return "drop-newest";
+    case BufferPolicy::latestOnly:    return "latest-only";
+  }
+  return "unknown";
+}
+
+// Bounded multi-producer/multi-consumer ring buffer with the interface of
+// ConcurrentCircularBuffer. send() and receive() of a non-empty buffer only
+// touch atomics (per-slot sequence numbers, as in D. Vyukov's bounded MPMC
+// queue). A receive() on an empty buffer suspends the calling HPX task on
+// an HPX condition variable instead of blocking the worker OS thread, so
+// receive() must be called from an HPX thread.
+// What send() does on a full buffer is chosen by a BufferPolicy, the default
+// (dropOldest) overwrites the oldest element like ConcurrentCircularBuffer.
+// The buffer counts overwritten and dropped elements and the time elements
+// spend queued, so that freshness can be traded against completeness.
+template <typename T>
+class ConcurrentRingBuffer : private boost::noncopyable
+{
+public:
+  typedef hpx::lcos::local::mutex mutex_type;
+  typedef std::chrono::steady_clock clock;
+
+  // With a single slot the sequence number a push leaves behind equals the
+  // position of the next push, which would then overwrite the unread element
+  static const int MIN_CAPACITY = 2;
+
+  ConcurrentRingBuffer() : ConcurrentRingBuffer(MIN_CAPACITY) {}
+  ConcurrentRingBuffer(int n, BufferPolicy policy = BufferPolicy::dropOldest)
+    : policy(policy), waiters(0), producer_waiters(0), overwritten(0), dropped(0),
+      queueDelay_us(0) {
+    this->allocate(n);
+  }
+
+  // returns false if the element was dropped
+  bool send(T imdata) {
+    bool accepted = true;
+    if (this->policy == BufferPolicy::latestOnly) {
+      // the mailbox only ever holds the newest element
+      T older;
+      while (this->try_pop(older)) {
+        this->overwritten++;
+      }
+    }
+    while (!this->try_push(imdata)) {
+      if (this->policy == BufferPolicy::dropNewest) {
+        this->dropped++;
+        accepted = false;
+        break;
+      }
+      if (this->policy == BufferPolicy::blockProducer) {
+        this->wait_not_full();
+        continue;
+      }
+      // drop the oldest element to make room
+      T oldest;
+      if (this->try_pop(oldest)) {
+        this->overwritten++;
+      }
+    }
+    if (accepted) {
+      this->notify_not_empty();
+    }
+    return accepted;
+  }
+
+  // send() which never waits or evicts whatever the policy, returns false
+  // if the buffer is full. A full buffer has nothing to wake, so this is the
+  // way to wake a receiver blocked on an empty buffer, e.g. at shutdown
+  bool try_send(T imdata) {
+    if (!this->try_push(imdata)) {
+      return false;
+    }
+    this->notify_not_empty();
+    return true;
+  }
+
+  T receive() {
+    T imdata;
+    clock::time_point sent;
+    if (!this->try_pop(imdata, &sent)) {
+      std::unique_lock<mutex_type> lk(this->monitor);
+      ++this->waiters;
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      // a sender which did not see the increment of waiters has already
+      // published its element, so it is found by this try_pop
+      while (!this->try_pop(imdata, &sent)) {
+        this->buffer_not_empty.wait(lk);
+      }
+      --this->waiters;
+    }
+    // only the received elements count, not the evicted or cleared ones;
+    // concurrent consumers may lose an update, fine for a moving average
+    std::int64_t delay_us = std::chrono::duration_cast<std::chrono::microseconds>(
+            clock::now() - sent).count();
+    this->queueDelay_us.store((7 * this->queueDelay_us.load(std::memory_order_relaxed) + delay_us) / 8,
+                              std::memory_order_relaxed);
+    this->notify_not_full();
+    return imdata;
+  }
+
+  BufferPolicy getPolicy() { return this->policy; }
+  // elements overwritten by drop-oldest and latest-only
+  std::int64_t getOverwritten() { return this->overwritten; }
+  // elements discarded by drop-newest
+  std::int64_t getDropped() { return this->dropped; }
+  // moving average of the time between send() and receive()
+  int getQueueDelay_us() { return static_cast<int>(this->queueDelay_us); }
+
+  void clear() {
+    T imdata;
+    while (this->try_pop(imdata)) {}
+    this->notify_not_full();
+  }
+
+  int size() {
+    std::size_t enqueued = this->enqueue_pos.load(std::memory_order_relaxed);
+    std::size_t dequeued = this->dequeue_pos.load(std::memory_order_relaxed);
+    return enqueued > dequeued ? static_cast<int>(enqueued - dequeued) : 0;
+  }
+
+  // Drops the buffered elements. Unlike the other functions it must not run
+  // concurrently with send() or receive(), stop the producer and the consumer
+  // first. The sequence numbers need at least two slots, a latest-only buffer
+  // has two slots but keeps only the newest element.
+  void set_capacity(int capacity) {
+    this->allocate(capacity);
+  }
+
+private:
+  struct cell {
+    std::atomic<std::size_t> sequence;
+    T data;
+    clock::time_point sent;
+  };
+
+  void allocate(int n) {
+    this->capacity = static_cast<std::size_t>(n > MIN_CAPACITY ? n : MIN_CAPACITY);
+    if (this->policy == BufferPolicy::latestOnly) {
+      this->capacity = MIN_CAPACITY;
+    }
+    this->cells.reset(new cell[this->capacity]);
+    for (std::size_t i = 0; i < this->capacity; ++i) {
+      this->cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    this->enqueue_pos.store(0, std::memory_order_relaxed);
+    this->dequeue_pos.store(0, std::memory_order_release);
+  }
+
+  bool try_push(T &imdata) {
+    std::size_t pos = this->enqueue_pos.load(std::memory_order_relaxed);
+    for (;;) {
+      cell &c = this->cells[pos % this->capacity];
+      std::size_t seq = c.sequence.load(std::memory_order_acquire);
+      std::ptrdiff_t diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos);
+      if (diff == 0) {
+        if (this->enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+          c.data = std::move(imdata);
+          c.sent = clock::now();
+          c.sequence.store(pos + 1, std::memory_order_release);
+          return true;
+        }
+      }
+      else if (diff < 0) {
+        return false;   // full
+      }
+      else {
+        pos = this->enqueue_pos.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  // sent, if given, receives the time the element was pushed
+  bool try_pop(T &imdata, clock::time_point *sent = nullptr) {
+    std::size_t pos = this->dequeue_pos.load(std::memory_order_relaxed);
+    for (;;) {
+      cell &c = this->cells[pos % this->capacity];
+      std::size_t seq = c.sequence.load(std::memory_order_acquire);
+      std::ptrdiff_t diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos + 1);
+      if (diff == 0) {
+        if (this->dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+          imdata = std::move(c.data);
+          // release the reference held by the slot right away
+          c.data = T();
+          if (sent) {
+            *sent = c.sent;
+          }
+          c.sequence.store(pos + this->capacity, std::memory_order_release);
+          return true;
+        }
+      }
+      else if (diff < 0) {
+        return false;   // empty
+      }
+      else {
+        pos = this->dequeue_pos.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  void notify_not_empty() {
+    // pairs with the fence in receive(): either the sender sees the waiter
+    // or the waiter sees the element
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (this->waiters.load() > 0) {
+      std::lock_guard<mutex_type> lk(this->monitor);
+      this->buffer_not_empty.notify_one();
+    }
+  }
+
+  // same protocol as receive() and send() with the roles swapped
+  void wait_not_full() {
+    std::unique_lock<mutex_type> lk(this->monitor);
+    ++this->producer_waiters;
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (this->size() >= static_cast<int>(this->capacity)) {
+      this->buffer_not_full.wait(lk);
+    }
+    --this->producer_waiters;
+  }
+
+  void notify_not_full() {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (this->producer_waiters.load() > 0) {
+      std::lock_guard<mutex_type> lk(this->monitor);
+      this->buffer_not_full.notify_all();
+    }
+  }
+
+  BufferPolicy                      policy;
+  std::size_t                       capacity;
+  std::unique_ptr<cell[]>           cells;
+  // producers and consumers on separate cache lines
+  alignas(64) std::atomic<std::size_t> enqueue_pos;
+  alignas(64) std::atomic<std::size_t> dequeue_pos;
+  alignas(64) std::atomic<int>      waiters;
+  std::atomic<int>                  producer_waiters;
+  std::atomic<std::int64_t>         overwritten;
+  std::atomic<std::int64_t>         dropped;
+  std::atomic<std::int64_t>         queueDelay_us;
+  mutex_type                        monitor;
+  hpx::lcos::local::condition_variable buffer_not_empty;
+  hpx::lcos::local::condition_variable buffer_not_full;
+};
+
+#endif
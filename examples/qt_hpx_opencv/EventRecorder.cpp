@@ -0,0 +1,224 @@
+#include "EventRecorder.hpp"
+//
+#include <opencv2/imgcodecs/imgcodecs.hpp>
+#include <opencv2/videoio/videoio.hpp>
+#include "opencv2/videoio/videoio_c.h"
+//
+#include <hpx/include/async.hpp>
+//
+#include "blocking_detector.hpp"
+#include "OverlayCompositor.hpp"
+//
+#include <boost/make_shared.hpp>
+//
+#include <algorithm>
+#include <chrono>
+#include <ctime>
+#include <iostream>
+#include <mutex>
+#include <utility>
+
+//----------------------------------------------------------------------------
+EventRecorder::EventRecorder(const EventRecorderParams &params, const priority_lanes &lanes)
+  : params(params), lanes(lanes), nextTicket(0), nextStored(0), bytes(0),
+    frameInterval(0.0), writing(hpx::make_ready_future()),
+    recording(false), events(0), recordedFrames(0), droppedFrames(0)
+{
+}
+//----------------------------------------------------------------------------
+EventRecorder::~EventRecorder()
+{
+  this->finish();
+}
+//----------------------------------------------------------------------------
+void EventRecorder::finish()
+{
+  // the frames being compressed still belong to the clip
+  for (hpx::future<void> &f : this->encodes) {
+    f.wait();
+  }
+  this->encodes.clear();
+  {
+    std::lock_guard<mutex_type> lk(this->mtx);
+    if (this->clip) {
+      this->clip->open = false;
+      this->clip.reset();
+      this->recording = false;
+    }
+    this->packetsReady.notify_all();
+  }
+  this->writing.wait();
+}
+//----------------------------------------------------------------------------
+void EventRecorder::addFrame(const cv::Mat &image, Frame::clock::time_point captureTime)
+{
+  // compression falls behind, keep the capture going
+  const std::size_t MAX_PENDING_ENCODES = 8;
+  this->encodes.erase(std::remove_if(this->encodes.begin(), this->encodes.end(),
+                                     [](const hpx::future<void> &f) { return f.is_ready(); }),
+                      this->encodes.end());
+  if (this->encodes.size() >= MAX_PENDING_ENCODES) {
+    this->droppedFrames++;
+    return;
+  }
+  std::uint64_t ticket;
+  {
+    std::lock_guard<mutex_type> lk(this->mtx);
+    ticket = this->nextTicket++;
+  }
+  this->encodes.push_back(hpx::async(this->lanes.background,
+          blocking_detector::annotate("EventRecorder::encode", &EventRecorder::encode),
+          this, ticket, image, captureTime));
+}
+//----------------------------------------------------------------------------
+void EventRecorder::encode(std::uint64_t ticket, cv::Mat image, Frame::clock::time_point captureTime)
+{
+  Packet packet;
+  packet.time = captureTime;
+  try {
+    std::vector<int> options = {cv::IMWRITE_JPEG_QUALITY, this->params.jpegQuality};
+    cv::imencode(".jpg", image, packet.jpeg, options);
+  }
+  catch (const std::exception &e) {
+    // cv::Exception, or std::bad_alloc from the buffer; the empty packet
+    // keeps the ticket, the frames after it are stored all the same
+    std::cout << "EventRecorder: frame dropped, " << e.what() << std::endl;
+    packet.jpeg.clear();
+  }
+  catch (...) {
+    std::cout << "EventRecorder: frame dropped" << std::endl;
+    packet.jpeg.clear();
+  }
+  // the frame goes back to the pool
+  image.release();
+
+  // the encodes finish in any order, the frames are stored in capture order
+  std::lock_guard<mutex_type> lk(this->mtx);
+  this->encoded.emplace(ticket, std::move(packet));
+  while (!this->encoded.empty() && this->encoded.begin()->first == this->nextStored) {
+    this->store(std::move(this->encoded.begin()->second));
+    this->encoded.erase(this->encoded.begin());
+    this->nextStored++;
+  }
+}
+//----------------------------------------------------------------------------
+// With the lock held: appends the frame to the open clip, or to the ring
+void EventRecorder::store(Packet &&packet)
+{
+  if (packet.jpeg.empty()) {
+    this->droppedFrames++;
+    return;
+  }
+  if (this->lastStored != Frame::clock::time_point()) {
+    double interval = std::chrono::duration<double>(packet.time - this->lastStored).count();
+    this->frameInterval = this->frameInterval > 0 ?
+                          0.9*this->frameInterval + 0.1*interval : interval;
+  }
+  this->lastStored = packet.time;
+  // the clip ends postTrigger seconds after the last motion
+  if (this->clip && packet.time > this->clipEnd) {
+    this->clip->open = false;
+    this->clip.reset();
+    this->recording = false;
+    this->packetsReady.notify_all();
+  }
+  std::size_t size = packet.jpeg.size();
+  if (this->clip) {
+    // the writer fell behind
+    if (this->bytes + size > this->params.maxBytes) {
+      this->droppedFrames++;
+      return;
+    }
+    this->bytes += size;
+    this->clip->packets.push_back(std::move(packet));
+    this->packetsReady.notify_all();
+  }
+  else {
+    this->bytes += size;
+    this->ring.push_back(std::move(packet));
+    this->trimRing();
+  }
+}
+//----------------------------------------------------------------------------
+void EventRecorder::trimRing()
+{
+  Frame::clock::duration keep = std::chrono::duration_cast<Frame::clock::duration>(
+          std::chrono::duration<double>(this->params.preTrigger));
+  while (!this->ring.empty() &&
+         (this->ring.back().time - this->ring.front().time > keep ||
+          this->bytes > this->params.maxBytes)) {
+    this->bytes -= this->ring.front().jpeg.size();
+    this->ring.pop_front();
+  }
+}
+//----------------------------------------------------------------------------
+void EventRecorder::trigger(bool motion, Frame::clock::time_point captureTime)
+{
+  if (!motion) {
+    return;
+  }
+  std::lock_guard<mutex_type> lk(this->mtx);
+  this->clipEnd = captureTime + std::chrono::duration_cast<Frame::clock::duration>(
+          std::chrono::duration<double>(this->params.postTrigger));
+  if (this->clip) {
+    return;
+  }
+  // a new clip, starting with the frames of the ring
+  char date[32];
+  std::tm now = OverlayCompositor::localTime(std::time(nullptr));
+  std::strftime(date, sizeof(date), "%Y%m%d-%H%M%S", &now);
+  this->clip = boost::make_shared<Clip>();
+  this->clip->path = this->params.directory + "/" + this->params.prefix + "event-" + date +
+                     "-" + std::to_string(this->events.load()) + ".avi";
+  this->clip->fps  = this->frameInterval > 0 ? 1.0/this->frameInterval : 25.0;
+  this->clip->open = true;
+  this->clip->packets.swap(this->ring);
+  this->events++;
+  this->recording = true;
+  // clips are written one after the other
+  Clip_SP clip = this->clip;
+  this->writing = this->writing.then(this->lanes.blocking,
+    [this, clip](hpx::future<void> &&) {
+      this->writeClip(clip);
+    });
+}
+//----------------------------------------------------------------------------
+// On the blocking lane: decodes the frames of the clip as they come and
+// writes them until the clip is closed
+void EventRecorder::writeClip(Clip_SP clip)
+{
+  cv::VideoWriter writer;
+  bool failed = false;
+  std::unique_lock<mutex_type> lk(this->mtx);
+  for (;;) {
+    while (clip->packets.empty() && clip->open) {
+      this->packetsReady.wait(lk);
+    }
+    if (clip->packets.empty()) {
+      break;
+    }
+    Packet packet = std::move(clip->packets.front());
+    clip->packets.pop_front();
+    this->bytes -= packet.jpeg.size();
+    lk.unlock();
+    //
+    cv::Mat image = cv::imdecode(packet.jpeg, cv::IMREAD_COLOR);
+    if (!writer.isOpened() && !failed && !image.empty()) {
+      writer.open(clip->path, CV_FOURCC('X', 'V', 'I', 'D'), clip->fps, image.size());
+      if (!writer.isOpened()) {
+        std::cout << "Failed to create event writer " << clip->path << std::endl;
+        failed = true;
+      }
+    }
+    bool written = writer.isOpened() && !image.empty();
+    if (written) {
+      writer.write(image);
+    }
+    //
+    lk.lock();
+    if (written) this->recordedFrames++;
+    else this->droppedFrames++;
+  }
+  lk.unlock();
+  writer.release();
+}
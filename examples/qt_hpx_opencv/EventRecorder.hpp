@@ -0,0 +1,116 @@
+#ifndef EVENT_RECORDER_H
+#define EVENT_RECORDER_H
+
+#include <hpx/config.hpp>
+#include <hpx/lcos/future.hpp>
+#include <hpx/lcos/local/condition_variable.hpp>
+#include <hpx/lcos/local/mutex.hpp>
+//
+#include <opencv2/core/core.hpp>
+//
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+//
+#include "Frame.hpp"
+#include "priority_lanes.hpp"
+//
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+class EventRecorder;
+typedef boost::shared_ptr<EventRecorder> EventRecorder_SP;
+
+struct EventRecorderParams {
+    bool        enabled;
+    std::string directory;
+    std::string prefix;           // start of the file names, before the date
+    double      preTrigger;       // seconds kept before the motion started
+    double      postTrigger;      // seconds recorded after the motion ended
+    double      triggerLevel;     // MotionFilter::triggerLevel while recording
+    int         jpegQuality;
+    std::size_t maxBytes;         // compressed frames held, ring and clips
+};
+
+//
+// Records a clip around every motion event.
+//
+// The capture hands over every frame; it is compressed to JPEG on the
+// background lane and kept in a ring holding the last preTrigger seconds.
+// When the processing reports motion the ring becomes the start of a clip,
+// the following frames are appended to it until postTrigger seconds after
+// the last motion, and a task on the blocking lane decodes the clip and
+// writes it with a cv::VideoWriter. Neither addFrame() nor trigger() waits
+// for the encoder or the disk: frames are dropped instead when too many are
+// being compressed or the compressed frames exceed maxBytes.
+//
+class EventRecorder : private boost::noncopyable
+{
+public:
+  EventRecorder(const EventRecorderParams &params, const priority_lanes &lanes);
+  // finishes the open clip
+  ~EventRecorder();
+
+  // from the capture, image must not be written to afterwards
+  void addFrame(const cv::Mat &image, Frame::clock::time_point captureTime);
+  // from the processing, after the motion detection of the frame
+  void trigger(bool motion, Frame::clock::time_point captureTime);
+  // closes the open clip and waits until it is written, once no more
+  // frames are added
+  void finish();
+
+  const EventRecorderParams &getParams() { return this->params; }
+  bool    isRecording() { return this->recording; }
+  int64_t getEvents() { return this->events; }
+  int64_t getRecordedFrames() { return this->recordedFrames; }
+  int64_t getDroppedFrames() { return this->droppedFrames; }
+
+private:
+  typedef hpx::lcos::local::mutex mutex_type;
+
+  struct Packet {
+    Frame::clock::time_point time;
+    std::vector<uchar>       jpeg;
+  };
+  struct Clip {
+    std::string         path;
+    double              fps;
+    bool                open;
+    std::deque<Packet>  packets;
+  };
+  typedef boost::shared_ptr<Clip> Clip_SP;
+
+  void encode(std::uint64_t ticket, cv::Mat image, Frame::clock::time_point captureTime);
+  void store(Packet &&packet);
+  void trimRing();
+  void writeClip(Clip_SP clip);
+
+  EventRecorderParams params;
+  priority_lanes      lanes;
+  mutex_type          mtx;
+  hpx::lcos::local::condition_variable packetsReady;
+  // compressed frames in capture order
+  std::map<std::uint64_t, Packet> encoded;
+  std::uint64_t       nextTicket;
+  std::uint64_t       nextStored;
+  std::deque<Packet>  ring;
+  std::size_t         bytes;
+  Frame::clock::time_point lastStored;
+  double              frameInterval;    // seconds, smoothed, for the clip frame rate
+  Clip_SP             clip;
+  Frame::clock::time_point clipEnd;
+  hpx::future<void>   writing;
+  // compressions in flight, only used by addFrame()
+  std::vector<hpx::future<void>> encodes;
+  //
+  std::atomic<bool>    recording;
+  std::atomic<int64_t> events;
+  std::atomic<int64_t> recordedFrames;
+  std::atomic<int64_t> droppedFrames;
+};
+
+#endif
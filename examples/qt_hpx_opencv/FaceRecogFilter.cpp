@@ -1,55 +1,39 @@
 #include "filter.hpp"
 #include "FaceRecogFilter.hpp"
+#include "OverlayCompositor.hpp"
 //
 #include <opencv2/core/core.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
 #include "opencv2/videoio/videoio_c.h"
 #include "opencv2/imgproc/imgproc_c.h"
 //
-#include <QDateTime>
-#include <QString>
-//
 #include <config.h>
 //
+#include <utility>
+//
 //----------------------------------------------------------------------------
 FaceRecogFilter::FaceRecogFilter()
-        : cascade(),
-          nestedCascade(),
-          scale(1.0),
+        : scale(1.0),
           renderer(nullptr),
+          loadedClassifiers(0),
           imageSize(cv::Size(-1,-1)),
           eyesRecogState(false),
           inputImage(),
           outputImage() {
   // Load classifiers
-  std::string nestedCascadePath = DATA_PATH +
-          std::string("/models/haarcascade_eye_tree_eyeglasses.xml");
-  std::string cascadePath = DATA_PATH +
-          std::string("/models/haarcascade_frontalface_default.xml");
-
-  if(eyesRecogState)
-    nestedCascade.load(nestedCascadePath);
-  cascade.load(cascadePath);
+  this->reserveClassifiers(1);
 }
 //----------------------------------------------------------------------------
 FaceRecogFilter::FaceRecogFilter(FaceRecogFilterParams frfp)
-        : cascade(),
-          nestedCascade(),
-          renderer(nullptr),
+        : renderer(nullptr),
+          loadedClassifiers(0),
           imageSize(cv::Size(-1,-1)),
           eyesRecogState(frfp.detectEyes),
           inputImage(),
           outputImage() {
   // Load classifiers
   setDecimationCoeff(frfp.decimationCoeff);
-  std::string nestedCascadePath = DATA_PATH +
-                                  std::string("/models/haarcascade_eye_tree_eyeglasses.xml");
-  std::string cascadePath = DATA_PATH +
-                            std::string("/models/haarcascade_frontalface_default.xml");
-
-
-  nestedCascade.load(nestedCascadePath);
-  cascade.load(cascadePath);
+  this->reserveClassifiers(1);
 }
 //----------------------------------------------------------------------------
 FaceRecogFilter::~FaceRecogFilter()
@@ -65,6 +49,15 @@ void FaceRecogFilter::DeleteTemporaryStorage()
 //----------------------------------------------------------------------------
 void FaceRecogFilter::process(const cv::Mat &img)
 {
+  this->detect(img);
+  this->render(img);
+}
+//----------------------------------------------------------------------------
+void FaceRecogFilter::detect(const cv::Mat &img)
+{
+  std::unique_ptr<Classifiers> classifiers = this->acquireClassifiers();
+  cv::CascadeClassifier &cascade = classifiers->cascade;
+  cv::CascadeClassifier &nestedCascade = classifiers->nestedCascade;
 
   std::vector<cv::Rect> faces, faces2;
   cv::Mat gray, smallImg;
@@ -117,12 +110,13 @@ void FaceRecogFilter::process(const cv::Mat &img)
   //
   // Add time and data to image
   //
-  QString timestring = QDateTime::currentDateTime().toString("dd/MM/yyyy hh:mm:ss");
-  this->text_size = cv::getTextSize( timestring.toLatin1().data(), CV_FONT_HERSHEY_PLAIN, 1.0, 1, NULL);
+  OverlayCompositor::instance().timestamp(img);
 
-  cv::putText(img, timestring.toLatin1().data(),
-  cvPoint(img.size().width - text_size.width - 4, text_size.height+4),
-    CV_FONT_HERSHEY_PLAIN, 1.0, cv::Scalar(255, 255, 255, 0), 1);
+  this->releaseClassifiers(std::move(classifiers));
+}
+//----------------------------------------------------------------------------
+void FaceRecogFilter::render(const cv::Mat &img)
+{
   //
   // Pass final image to GUI
   //
@@ -130,6 +124,54 @@ void FaceRecogFilter::process(const cv::Mat &img)
     renderer->process(img);
   }
 }
+//----------------------------------------------------------------------------
+// The sets taken are held until enough are loaded, a set put back right
+// away would only be taken again
+void FaceRecogFilter::reserveClassifiers(int n)
+{
+  std::vector<std::unique_ptr<Classifiers>> reserved;
+  while (true) {
+    {
+      std::lock_guard<std::mutex> lock(this->classifiersLock);
+      if (this->loadedClassifiers >= n) {
+        break;
+      }
+    }
+    reserved.push_back(this->acquireClassifiers());
+  }
+  for (std::unique_ptr<Classifiers> &classifiers : reserved) {
+    this->releaseClassifiers(std::move(classifiers));
+  }
+}
+//----------------------------------------------------------------------------
+// Takes a set of classifiers from the pool, loads a new one when all are in use
+std::unique_ptr<FaceRecogFilter::Classifiers> FaceRecogFilter::acquireClassifiers()
+{
+  {
+    std::lock_guard<std::mutex> lock(this->classifiersLock);
+    if (!this->classifiers.empty()) {
+      std::unique_ptr<Classifiers> classifiers = std::move(this->classifiers.back());
+      this->classifiers.pop_back();
+      return classifiers;
+    }
+    this->loadedClassifiers++;
+  }
+  std::string nestedCascadePath = DATA_PATH +
+                                  std::string("/models/haarcascade_eye_tree_eyeglasses.xml");
+  std::string cascadePath = DATA_PATH +
+                            std::string("/models/haarcascade_frontalface_default.xml");
+
+  std::unique_ptr<Classifiers> classifiers(new Classifiers());
+  classifiers->nestedCascade.load(nestedCascadePath);
+  classifiers->cascade.load(cascadePath);
+  return classifiers;
+}
+//----------------------------------------------------------------------------
+void FaceRecogFilter::releaseClassifiers(std::unique_ptr<Classifiers> classifiers)
+{
+  std::lock_guard<std::mutex> lock(this->classifiersLock);
+  this->classifiers.push_back(std::move(classifiers));
+}
 void FaceRecogFilter::setDecimationCoeff(int val){
   this->scale = static_cast<double>(100) / val;
 //
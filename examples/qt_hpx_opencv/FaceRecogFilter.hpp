@@ -7,6 +7,10 @@
 #include <opencv2/imgproc.hpp>
 //
 #include "boost/shared_ptr.hpp"
+//
+#include <memory>
+#include <mutex>
+#include <vector>
 
 class FaceRecogFilter;
 typedef boost::shared_ptr<FaceRecogFilter> FaceRecogFilter_SP;
@@ -17,7 +21,11 @@ struct FaceRecogFilterParams {
 
 };
 //
-// Filter which performs face recognition
+// Filter which performs face recognition.
+// The filter keeps no state between frames, so several frames may be
+// detected at the same time. A CascadeClassifier must not be used by two
+// detections at once, each detection takes a set of classifiers from a pool
+// which grows to the number of concurrent detections.
 //
 class FaceRecogFilter {
 public:
@@ -26,6 +34,12 @@ public:
   ~FaceRecogFilter();
   //
   virtual void process(const cv::Mat &image);
+  // the two halves of process(): marks the faces found in the image, may
+  // be called concurrently, and passes the image to the renderer
+  void detect(const cv::Mat &image);
+  void render(const cv::Mat &image);
+  // load the classifiers for n concurrent detections up front
+  void reserveClassifiers(int n);
   //
   void setDecimationCoeff(int val);
   void setEyesRecogState(bool state) { this->eyesRecogState = state; }
@@ -35,19 +49,26 @@ public:
   void setRenderer(Filter* renderer) {this->renderer = renderer; }
 
 protected:
+  struct Classifiers {
+    cv::CascadeClassifier cascade;
+    cv::CascadeClassifier nestedCascade;
+  };
+  std::unique_ptr<Classifiers> acquireClassifiers();
+  void releaseClassifiers(std::unique_ptr<Classifiers> classifiers);
+
   Filter      *renderer;
   //
   // input variables
   //
-  cv::CascadeClassifier cascade;
-  cv::CascadeClassifier nestedCascade;
+  std::mutex            classifiersLock;
+  std::vector<std::unique_ptr<Classifiers>> classifiers;
+  int                   loadedClassifiers;
   double                scale;
   cv::Size              imageSize;
   int                   frameCount;
   bool                  eyesRecogState;
   cv::Mat               inputImage;
   cv::Mat               outputImage;
-  cv::Size              text_size;
 };
 
 #endif
@@ -0,0 +1,30 @@
+#ifndef FRAME_H
+#define FRAME_H
+
+#include <opencv2/core/core.hpp>
+//
+#include <chrono>
+#include <cstdint>
+#include <utility>
+
+//
+// A captured frame on its way through the pipeline. The capture stage
+// creates a fresh Frame for every image and moves it into the buffer, the
+// stage which receives it owns the image and may modify it in place.
+// An empty image marks the end of the stream.
+//
+struct Frame {
+    typedef std::chrono::steady_clock clock;
+
+    Frame() : sequence(0) {}
+    Frame(cv::Mat image, std::uint64_t sequence, clock::time_point captureTime)
+      : image(std::move(image)), sequence(sequence), captureTime(captureTime) {}
+
+    cv::Mat           image;
+    std::uint64_t     sequence;       // number of the frame since the capture started
+    clock::time_point captureTime;    // when the image was read from the device
+    clock::time_point queuedTime;     // when the capture handed it to processing
+    clock::time_point receivedTime;   // when the processing took it
+};
+
+#endif
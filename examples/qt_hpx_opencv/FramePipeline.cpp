@@ -0,0 +1,160 @@
+#include "FramePipeline.hpp"
+//
+#include <hpx/include/async.hpp>
+#include <hpx/lcos/dataflow.hpp>
+#include <hpx/include/threads.hpp>
+//
+#include <algorithm>
+#include <exception>
+#include <iostream>
+#include <mutex>
+#include <utility>
+//
+#include "blocking_detector.hpp"
+
+//----------------------------------------------------------------------------
+FramePipeline::FramePipeline(const priority_lanes &lanes, int framesInFlight)
+  : lanes(lanes), maxFramesInFlight(std::max(1, framesInFlight)), framesInFlight(0),
+    grabbing(false), grabPending(false), lastFiltered(hpx::make_ready_future())
+{
+}
+//----------------------------------------------------------------------------
+void FramePipeline::setCaptureThread(CaptureThread_SP capture)
+{
+  std::lock_guard<mutex_type> lk(this->mtx);
+  this->captureThread = capture;
+  if (capture) {
+    capture->setExternalDriver([this]() { this->start(); });
+  }
+}
+//----------------------------------------------------------------------------
+void FramePipeline::setProcessingThread(ProcessingThread_SP processing)
+{
+  std::lock_guard<mutex_type> lk(this->mtx);
+  this->processingThread = processing;
+}
+//----------------------------------------------------------------------------
+// called by CaptureThread::startCapture()
+void FramePipeline::start()
+{
+  CaptureThread_SP capture;
+  {
+    std::lock_guard<mutex_type> lk(this->mtx);
+    if (this->grabbing || !this->captureThread) {
+      return;
+    }
+    this->grabbing = true;
+    capture = this->captureThread;
+  }
+  this->launchFrame(capture);
+}
+//----------------------------------------------------------------------------
+// Chains the stages of the next frame. The lock is held until the chain is
+// complete, so the grab, which decides about the next frame, can't overtake
+// the update of lastFiltered.
+void FramePipeline::launchFrame(CaptureThread_SP capture)
+{
+  std::lock_guard<mutex_type> lk(this->mtx);
+  ++this->framesInFlight;
+
+  hpx::future<Frame> grabbed = hpx::async(this->lanes.blocking,
+      blocking_detector::annotate("FramePipeline::grab", &FramePipeline::grab), this, capture);
+
+  hpx::future<Frame> prepared = grabbed.then(this->lanes.frame_critical,
+    blocking_detector::annotate("FramePipeline::prepare", [capture](hpx::future<Frame> &&f) {
+      Frame frame = f.get();
+      if (!frame.image.empty()) {
+        capture->prepareFrame(frame);
+      }
+      return frame;
+    }));
+
+  // the previous frame is only waited for, its result is not used
+  this->lastFiltered = hpx::dataflow(this->lanes.frame_critical,
+    blocking_detector::annotate("FramePipeline::filter",
+                                [this, capture](hpx::future<Frame> f, hpx::shared_future<void>) {
+      try {
+        Frame frame = f.get();
+        if (!frame.image.empty()) {
+          capture->recordFrame(frame);
+          frame.queuedTime = Frame::clock::now();
+          this->process(frame);
+        }
+      }
+      catch (const std::exception &e) {
+        std::cout << "FramePipeline: frame dropped, " << e.what() << std::endl;
+      }
+      catch (...) {
+        std::cout << "FramePipeline: frame dropped" << std::endl;
+      }
+      this->frameDone(capture);
+    }),
+    std::move(prepared), this->lastFiltered).share();
+}
+//----------------------------------------------------------------------------
+Frame FramePipeline::grab(CaptureThread_SP capture)
+{
+  Frame frame;
+  bool grabbed = false;
+  if (!capture->isAborting()) {
+    // suspends this task only, the worker runs the other stages meanwhile
+    hpx::this_thread::sleep_until(capture->nextFrameDeadline());
+    try {
+      grabbed = capture->grabFrame(frame);
+    }
+    catch (const std::exception &e) {
+      // an exception would leave grabbing set and the pipeline would never
+      // report that it stopped, end it like after the last frame instead
+      capture->endCapture(std::string("FramePipeline: grab failed, ") + e.what());
+      frame = Frame();
+      grabbed = false;
+    }
+    catch (...) {
+      capture->endCapture("FramePipeline: grab failed");
+      frame = Frame();
+      grabbed = false;
+    }
+  }
+
+  std::unique_lock<mutex_type> lk(this->mtx);
+  if (!grabbed) {
+    // the empty frame still passes the stages, the last frame done
+    // tells the capture thread that the pipeline stopped
+    this->grabbing = false;
+  }
+  else if (this->framesInFlight < this->maxFramesInFlight) {
+    lk.unlock();
+    this->launchFrame(capture);
+  }
+  else {
+    this->grabPending = true;
+  }
+  return frame;
+}
+//----------------------------------------------------------------------------
+void FramePipeline::process(Frame &frame)
+{
+  ProcessingThread_SP processing;
+  {
+    std::lock_guard<mutex_type> lk(this->mtx);
+    processing = this->processingThread;
+  }
+  if (processing) {
+    processing->processFrame(frame);
+  }
+}
+//----------------------------------------------------------------------------
+void FramePipeline::frameDone(CaptureThread_SP capture)
+{
+  std::unique_lock<mutex_type> lk(this->mtx);
+  --this->framesInFlight;
+  if (this->grabPending) {
+    this->grabPending = false;
+    lk.unlock();
+    this->launchFrame(capture);
+  }
+  else if (!this->grabbing && this->framesInFlight == 0) {
+    lk.unlock();
+    capture->runFinished();
+  }
+}
@@ -0,0 +1,71 @@
+#ifndef FRAME_PIPELINE_H
+#define FRAME_PIPELINE_H
+
+#include <hpx/config.hpp>
+#include <hpx/lcos/future.hpp>
+#include <hpx/lcos/local/mutex.hpp>
+//
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+//
+#include "capturethread.hpp"
+#include "processingthread.hpp"
+#include "Frame.hpp"
+#include "priority_lanes.hpp"
+//
+#include <atomic>
+
+class FramePipeline;
+typedef boost::shared_ptr<FramePipeline> FramePipeline_SP;
+
+//
+// Alternative to the run() loops of CaptureThread and ProcessingThread.
+// Every frame is a chain of futures
+//
+//   grab (blocking lane) -> rotate/deinterlace (frame lane)
+//        -> caption/record + filter/render (frame lane, in frame order)
+//
+// and no task is bound to a loop. The next grab is launched when the
+// previous one finished and fewer than framesInFlight frames are in the
+// pipeline, otherwise when the oldest frame is done. Rotation and
+// deinterlacing of the frames in flight overlap with each other, with the
+// grab of the next frame and with the filtering of the previous one. The
+// filters keep state between frames, so that stage runs in frame order.
+//
+class FramePipeline : private boost::noncopyable
+{
+public:
+  FramePipeline(const priority_lanes &lanes, int framesInFlight);
+
+  // The pipeline drives the given capture: its startCapture() starts the
+  // grabbing and its stopCapture() returns when the frames in flight are done.
+  // Set a new capture thread before it is started, and reset it after it
+  // was stopped.
+  void setCaptureThread(CaptureThread_SP capture);
+  // frames grabbed while there is no processing thread are dropped
+  void setProcessingThread(ProcessingThread_SP processing);
+
+  int getFramesInFlight() { return this->framesInFlight; }
+  int getMaxFramesInFlight() { return this->maxFramesInFlight; }
+
+private:
+  typedef hpx::lcos::local::mutex mutex_type;
+
+  void start();
+  void launchFrame(CaptureThread_SP capture);
+  Frame grab(CaptureThread_SP capture);
+  void process(Frame &frame);
+  void frameDone(CaptureThread_SP capture);
+
+  priority_lanes            lanes;
+  int                       maxFramesInFlight;
+  mutex_type                mtx;
+  CaptureThread_SP          captureThread;
+  ProcessingThread_SP       processingThread;
+  std::atomic<int>          framesInFlight;
+  bool                      grabbing;       // the grabbing was started and not aborted
+  bool                      grabPending;    // the next grab waits for a frame to finish
+  hpx::shared_future<void>  lastFiltered;   // filter stage of the newest frame
+};
+
+#endif
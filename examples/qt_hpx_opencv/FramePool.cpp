@@ -0,0 +1,142 @@
+#include "FramePool.hpp"
+
+//----------------------------------------------------------------------------
+FramePool &FramePool::instance()
+{
+  static FramePool *pool = new FramePool();
+  return *pool;
+}
+//----------------------------------------------------------------------------
+FramePool::FramePool()
+  : requests(0), allocations(0), reuses(0), rateStart(std::chrono::steady_clock::now()),
+    rateStartAllocations(0), allocationsPerSecond(0.0)
+{
+}
+//----------------------------------------------------------------------------
+cv::Mat FramePool::create(const cv::Size &size, int type)
+{
+  cv::Mat mat;
+  mat.allocator = this;
+  mat.create(size, type);
+  return mat;
+}
+//----------------------------------------------------------------------------
+// Same layout as the default OpenCV allocator, only the buffer comes from
+// the free lists
+cv::UMatData *FramePool::allocate(int dims, const int *sizes, int type, void *data0,
+                                  size_t *step, int /*flags*/, cv::UMatUsageFlags /*usageFlags*/) const
+{
+  size_t total = CV_ELEM_SIZE(type);
+  for (int i = dims - 1; i >= 0; i--) {
+    if (step) {
+      if (data0 && step[i] != CV_AUTOSTEP) {
+        CV_Assert(total <= step[i]);
+        total = step[i];
+      }
+      else {
+        step[i] = total;
+      }
+    }
+    total *= sizes[i];
+  }
+
+  uchar *data = static_cast<uchar *>(data0);
+  if (!data) {
+    {
+      std::lock_guard<std::mutex> lk(this->freeListsLock);
+      FreeList &freeList = this->freeLists[total];
+      freeList.lastRequest = ++this->requests;
+      if (!freeList.buffers.empty()) {
+        data = freeList.buffers.back();
+        freeList.buffers.pop_back();
+      }
+      if (this->requests % PRUNE_INTERVAL == 0) {
+        this->prune();
+      }
+    }
+    if (data) {
+      this->reuses++;
+    }
+    else {
+      data = static_cast<uchar *>(cv::fastMalloc(total));
+      this->allocations++;
+    }
+  }
+
+  cv::UMatData *u = new cv::UMatData(this);
+  u->data = u->origdata = data;
+  u->size = total;
+  if (data0) {
+    u->flags |= cv::UMatData::USER_ALLOCATED;
+  }
+  return u;
+}
+//----------------------------------------------------------------------------
+bool FramePool::allocate(cv::UMatData *u, int /*accessflags*/, cv::UMatUsageFlags /*usageFlags*/) const
+{
+  return u != nullptr;
+}
+//----------------------------------------------------------------------------
+void FramePool::deallocate(cv::UMatData *u) const
+{
+  if (!u) {
+    return;
+  }
+  CV_Assert(u->urefcount == 0);
+  CV_Assert(u->refcount == 0);
+  if (!(u->flags & cv::UMatData::USER_ALLOCATED)) {
+    bool recycled = false;
+    {
+      std::lock_guard<std::mutex> lk(this->freeListsLock);
+      // the buffers of a size nobody asks for anymore are not kept
+      auto it = this->freeLists.find(u->size);
+      if (it != this->freeLists.end() && !this->isIdle(it->second) &&
+          it->second.buffers.size() < MAX_FREE_PER_SIZE) {
+        it->second.buffers.push_back(u->origdata);
+        recycled = true;
+      }
+    }
+    if (!recycled) {
+      cv::fastFree(u->origdata);
+    }
+    u->origdata = 0;
+  }
+  delete u;
+}
+//----------------------------------------------------------------------------
+bool FramePool::isIdle(const FreeList &freeList) const
+{
+  return this->requests - freeList.lastRequest > MAX_IDLE_REQUESTS;
+}
+//----------------------------------------------------------------------------
+// Frees the lists of the sizes which were not requested for a while, e.g.
+// the old resolution after a change
+void FramePool::prune() const
+{
+  for (auto it = this->freeLists.begin(); it != this->freeLists.end(); ) {
+    if (this->isIdle(it->second)) {
+      for (uchar *data : it->second.buffers) {
+        cv::fastFree(data);
+      }
+      it = this->freeLists.erase(it);
+    }
+    else {
+      ++it;
+    }
+  }
+}
+//----------------------------------------------------------------------------
+double FramePool::getAllocationsPerSecond()
+{
+  std::lock_guard<std::mutex> lk(this->rateLock);
+  std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+  double elapsed = std::chrono::duration<double>(now - this->rateStart).count();
+  if (elapsed >= 1.0) {
+    std::int64_t count = this->allocations;
+    this->allocationsPerSecond = (count - this->rateStartAllocations) / elapsed;
+    this->rateStartAllocations = count;
+    this->rateStart = now;
+  }
+  return this->allocationsPerSecond;
+}
+//----------------------------------------------------------------------------
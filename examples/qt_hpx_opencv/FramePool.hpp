@@ -0,0 +1,78 @@
+#ifndef FRAME_POOL_H
+#define FRAME_POOL_H
+
+#include <opencv2/core/core.hpp>
+//
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <vector>
+
+//
+// Recycling allocator for the frames of the capture->processing pipeline.
+// Mats created with (or attached to) the pool take their buffer from a free
+// list keyed by the buffer size, and give it back to the list when the last
+// Mat referencing it is released, instead of going through malloc/free for
+// every frame. Free lists are capped, and the lists of a size which has not
+// been requested for a while (the old resolution after a change, or the
+// colour buffers after switching to luma) are freed, so the pool does not
+// hoard buffers nobody asks for.
+//
+class FramePool : public cv::MatAllocator {
+public:
+  // process-wide pool, never destroyed, so that it outlives every Mat using it
+  static FramePool &instance();
+
+  // Mat of the given size and type with a buffer from the pool
+  cv::Mat create(const cv::Size &size, int type);
+  // let the next (re)allocation of an empty Mat use the pool, e.g. before
+  // VideoCapture::read or as the output of an OpenCV function
+  void attach(cv::Mat &mat) { mat.allocator = this; }
+
+  // cv::MatAllocator interface
+  cv::UMatData *allocate(int dims, const int *sizes, int type, void *data,
+                         size_t *step, int flags, cv::UMatUsageFlags usageFlags) const override;
+  bool allocate(cv::UMatData *data, int accessflags, cv::UMatUsageFlags usageFlags) const override;
+  void deallocate(cv::UMatData *data) const override;
+
+  // buffers taken from the heap and from a free list since the start
+  std::int64_t getAllocations() const { return this->allocations; }
+  std::int64_t getReuses() const { return this->reuses; }
+  // heap allocations per second, averaged over at least one second
+  double getAllocationsPerSecond();
+
+private:
+  FramePool();
+
+  static const std::size_t MAX_FREE_PER_SIZE = 8;
+  // a list is freed when its size was not among this many requests, a few
+  // hundred frames; the idle lists are looked for every PRUNE_INTERVAL
+  static const std::uint64_t MAX_IDLE_REQUESTS = 1024;
+  static const std::uint64_t PRUNE_INTERVAL = 64;
+
+  struct FreeList {
+    FreeList() : lastRequest(0) {}
+    std::vector<uchar *> buffers;
+    std::uint64_t        lastRequest;
+  };
+
+  // with freeListsLock held
+  bool isIdle(const FreeList &freeList) const;
+  void prune() const;
+
+  mutable std::mutex                                  freeListsLock;
+  mutable std::map<std::size_t, FreeList>             freeLists;
+  mutable std::uint64_t                               requests;
+  mutable std::atomic<std::int64_t>                   allocations;
+  mutable std::atomic<std::int64_t>                   reuses;
+  //
+  std::mutex                            rateLock;
+  std::chrono::steady_clock::time_point rateStart;
+  std::int64_t                          rateStartAllocations;
+  double                                allocationsPerSecond;
+};
+
+#endif
@@ -0,0 +1,262 @@
+#include "MjpegCapture.hpp"
+#include "FramePool.hpp"
+//
+#include <opencv2/imgcodecs/imgcodecs.hpp>
+#include "opencv2/videoio/videoio_c.h"
+//
+#include <hpx/include/async.hpp>
+#include <hpx/lcos/wait_all.hpp>
+//
+#include "blocking_detector.hpp"
+//
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <utility>
+
+namespace {
+  const std::string MJPEG_SCHEME = "mjpeg://";
+  const std::size_t READ_CHUNK = 64 * 1024;
+}
+
+//----------------------------------------------------------------------------
+MjpegCapture::MjpegCapture(hpx::threads::executors::pool_executor decodeExec)
+  : cv::VideoCapture(), decodeExecutor(std::move(decodeExec)), readAhead(4), loop(false),
+    endOfFile(true), scanned(0), size(0, 0), frameNumber(0)
+{
+}
+//----------------------------------------------------------------------------
+MjpegCapture::~MjpegCapture()
+{
+  this->release();
+}
+//----------------------------------------------------------------------------
+bool MjpegCapture::isMjpegURL(const std::string &URL)
+{
+  return URL.compare(0, MJPEG_SCHEME.size(), MJPEG_SCHEME) == 0;
+}
+//----------------------------------------------------------------------------
+bool MjpegCapture::open(const cv::String &URL)
+{
+  this->release();
+  std::string url(URL.c_str());
+  if (!isMjpegURL(url)) {
+    return false;
+  }
+
+  std::string rest = url.substr(MJPEG_SCHEME.size());
+  std::size_t query = rest.find('?');
+  this->path = rest.substr(0, query);
+  if (query != std::string::npos) {
+    std::istringstream pairs(rest.substr(query + 1));
+    std::string pair;
+    while (std::getline(pairs, pair, '&')) {
+      std::size_t eq = pair.find('=');
+      if (eq == std::string::npos) {
+        continue;
+      }
+      std::string key = pair.substr(0, eq);
+      std::string value = pair.substr(eq + 1);
+      if (key == "readahead") this->readAhead = std::max(1, std::atoi(value.c_str()));
+      else if (key == "loop") this->loop = std::atoi(value.c_str()) != 0;
+      else {
+        std::cout << "MjpegCapture: ignoring unknown parameter " << key << std::endl;
+      }
+    }
+  }
+
+  this->file.open(this->path.c_str(), std::ios::binary);
+  if (!this->file.is_open()) {
+    std::cout << "MjpegCapture: could not open " << this->path << std::endl;
+    return false;
+  }
+  this->endOfFile = false;
+
+  // the size of the stream is the size of its first frame
+  std::vector<uchar> packet;
+  if (!this->readPacket(packet)) {
+    std::cout << "MjpegCapture: no JPEG image in " << this->path << std::endl;
+    this->release();
+    return false;
+  }
+  cv::Mat first = decode(std::move(packet));
+  if (first.empty()) {
+    std::cout << "MjpegCapture: could not decode the first image of " << this->path << std::endl;
+    this->release();
+    return false;
+  }
+  this->size = first.size();
+  this->decoding.push_back(hpx::make_ready_future(first));
+  this->fillReadAhead();
+  return true;
+}
+//----------------------------------------------------------------------------
+bool MjpegCapture::open(int /*index*/)
+{
+  return false;
+}
+//----------------------------------------------------------------------------
+bool MjpegCapture::isOpened() const
+{
+  return this->file.is_open();
+}
+//----------------------------------------------------------------------------
+void MjpegCapture::release()
+{
+  // the decoding tasks own their packets, only wait for them to finish
+  hpx::wait_all(this->decoding);
+  this->decoding.clear();
+  if (this->file.is_open()) {
+    this->file.close();
+  }
+  this->endOfFile = true;
+  this->buffer.clear();
+  this->scanned = 0;
+  this->grabbed.release();
+}
+//----------------------------------------------------------------------------
+// Waits for the oldest frame being decoded and starts the decoding of the
+// next packet in its place
+bool MjpegCapture::grab()
+{
+  this->fillReadAhead();
+  if (this->decoding.empty()) {
+    this->grabbed.release();
+    return false;
+  }
+  this->grabbed = this->decoding.front().get();
+  this->decoding.pop_front();
+  this->fillReadAhead();
+  this->frameNumber++;
+  return !this->grabbed.empty();
+}
+//----------------------------------------------------------------------------
+bool MjpegCapture::retrieve(cv::OutputArray image, int /*flag*/)
+{
+  if (this->grabbed.empty()) {
+    image.release();
+    return false;
+  }
+  this->grabbed.copyTo(image);
+  return true;
+}
+//----------------------------------------------------------------------------
+bool MjpegCapture::read(cv::OutputArray image)
+{
+  if (this->grab()) {
+    return this->retrieve(image);
+  }
+  image.release();
+  return false;
+}
+//----------------------------------------------------------------------------
+// The decoded frame is handed over without a copy
+cv::VideoCapture &MjpegCapture::operator>>(cv::Mat &image)
+{
+  if (this->grab()) {
+    image = this->grabbed;
+    this->grabbed.release();
+  }
+  else {
+    image.release();
+  }
+  return *this;
+}
+//----------------------------------------------------------------------------
+bool MjpegCapture::set(int /*propId*/, double /*value*/)
+{
+  // the size and rate are those of the file
+  return false;
+}
+//----------------------------------------------------------------------------
+double MjpegCapture::get(int propId) const
+{
+  switch (propId) {
+    case CV_CAP_PROP_FRAME_WIDTH:  return this->size.width;
+    case CV_CAP_PROP_FRAME_HEIGHT: return this->size.height;
+    case CV_CAP_PROP_POS_FRAMES:   return static_cast<double>(this->frameNumber);
+    case CV_CAP_PROP_FOURCC:       return CV_FOURCC('M', 'J', 'P', 'G');
+    default:                       return 0;
+  }
+}
+//----------------------------------------------------------------------------
+void MjpegCapture::fillReadAhead()
+{
+  std::vector<uchar> packet;
+  while (static_cast<int>(this->decoding.size()) < this->readAhead && this->readPacket(packet)) {
+    this->decoding.push_back(hpx::async(this->decodeExecutor,
+        blocking_detector::annotate("MjpegCapture::decode", &MjpegCapture::decode), std::move(packet)));
+    packet = std::vector<uchar>();
+  }
+}
+//----------------------------------------------------------------------------
+cv::Mat MjpegCapture::decode(std::vector<uchar> packet)
+{
+  cv::Mat image;
+  FramePool::instance().attach(image);
+  cv::imdecode(packet, cv::IMREAD_COLOR, &image);
+  return image;
+}
+//----------------------------------------------------------------------------
+// A packet is a complete JPEG image, from its start of image marker (FF D8)
+// to the end of image marker (FF D9) which is followed by the start of the
+// next image or by the end of the file.
+bool MjpegCapture::readPacket(std::vector<uchar> &packet)
+{
+  while (true) {
+    // skip anything in front of the start of the image
+    std::size_t start = 0;
+    while (start + 1 < this->buffer.size() &&
+           !(this->buffer[start] == 0xFF && this->buffer[start + 1] == 0xD8)) {
+      start++;
+    }
+    if (start > 0) {
+      this->buffer.erase(this->buffer.begin(), this->buffer.begin() + start);
+      this->scanned = 0;
+    }
+
+    for (std::size_t i = std::max<std::size_t>(this->scanned, 2); i + 1 < this->buffer.size(); ++i) {
+      if (this->buffer[i] != 0xFF || this->buffer[i + 1] != 0xD9) {
+        continue;
+      }
+      std::size_t end = i + 2;
+      bool nextImage = end + 1 < this->buffer.size() &&
+                       this->buffer[end] == 0xFF && this->buffer[end + 1] == 0xD8;
+      bool lastImage = end == this->buffer.size() && this->endOfFile;
+      if (nextImage || lastImage) {
+        packet.assign(this->buffer.begin(), this->buffer.begin() + end);
+        this->buffer.erase(this->buffer.begin(), this->buffer.begin() + end);
+        this->scanned = 0;
+        return true;
+      }
+      if (end + 1 >= this->buffer.size()) {
+        // can't tell yet, look again when more data has been read
+        break;
+      }
+    }
+    if (this->buffer.size() > 3) {
+      this->scanned = this->buffer.size() - 3;
+    }
+
+    if (this->endOfFile) {
+      if (!this->loop || !this->file.is_open()) {
+        return false;
+      }
+      // start over, an incomplete image at the end is dropped
+      this->buffer.clear();
+      this->scanned = 0;
+      this->file.clear();
+      this->file.seekg(0);
+      this->endOfFile = false;
+    }
+
+    std::size_t old = this->buffer.size();
+    this->buffer.resize(old + READ_CHUNK);
+    this->file.read(reinterpret_cast<char *>(this->buffer.data() + old), READ_CHUNK);
+    this->buffer.resize(old + static_cast<std::size_t>(this->file.gcount()));
+    if (!this->file) {
+      this->endOfFile = true;
+    }
+  }
+}
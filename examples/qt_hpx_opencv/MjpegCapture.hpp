@@ -0,0 +1,72 @@
+#ifndef MJPEG_CAPTURE_H
+#define MJPEG_CAPTURE_H
+
+#include <hpx/config.hpp>
+#include <hpx/lcos/future.hpp>
+#include <hpx/parallel/executors/pool_executor.hpp>
+//
+#include <opencv2/core/core.hpp>
+#include <opencv2/videoio/videoio.hpp>
+//
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <string>
+#include <vector>
+
+//
+// Capture from a file of concatenated JPEG images (raw MJPEG, as written by
+// many IP cameras and by ffmpeg -f mjpeg). OpenCV decodes inside
+// VideoCapture::retrieve(), which can't overlap with the next grab(), so the
+// decoding of a high resolution stream is limited to one thread. Here the
+// compressed packets are read by the caller (on the blocking pool) and
+// decoded with cv::imdecode on the given executor, up to readahead frames
+// ahead; the frames are returned in file order. Opened with
+//
+//   mjpeg://<path>?readahead=4&loop=1
+//
+//   readahead : packets decoded ahead of the reader, 1 decodes in read()
+//   loop      : start over at the end of the file, for benchmarks
+//
+class MjpegCapture : public cv::VideoCapture {
+public:
+  explicit MjpegCapture(hpx::threads::executors::pool_executor decodeExec);
+  ~MjpegCapture();
+
+  static bool isMjpegURL(const std::string &URL);
+
+  bool open(const cv::String &URL) override;
+  bool open(int index) override;
+  bool isOpened() const override;
+  void release() override;
+
+  bool grab() override;
+  bool retrieve(cv::OutputArray image, int flag = 0) override;
+  bool read(cv::OutputArray image) override;
+  cv::VideoCapture &operator>>(cv::Mat &image) override;
+
+  bool set(int propId, double value) override;
+  double get(int propId) const override;
+
+private:
+  bool readPacket(std::vector<uchar> &packet);
+  void fillReadAhead();
+  static cv::Mat decode(std::vector<uchar> packet);
+
+  hpx::threads::executors::pool_executor decodeExecutor;
+  std::ifstream          file;
+  std::string            path;
+  int                    readAhead;
+  bool                   loop;
+  bool                   endOfFile;
+  //
+  std::vector<uchar>     buffer;        // bytes read but not yet returned as a packet
+  std::size_t            scanned;       // bytes of buffer searched for the end of the packet
+  std::deque<hpx::future<cv::Mat>> decoding;
+  cv::Mat                grabbed;       // result of grab(), returned by retrieve()
+  cv::Size               size;
+  std::int64_t           frameNumber;
+};
+
+#endif
@@ -0,0 +1,167 @@
+#include "Morphology.hpp"
+//
+#include <opencv2/core/core.hpp>
+#include <opencv2/core/hal/intrin.hpp>
+//
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+//----------------------------------------------------------------------------
+// The min (erode) or max (dilate) of two values, and the value of the pixels
+// outside the image: cv::erode and cv::dilate ignore them by default
+struct MinOp {
+  enum { NEUTRAL = 255 };
+  static uchar apply(uchar a, uchar b) { return std::min(a, b); }
+#if CV_SIMD128
+  static cv::v_uint8x16 apply(const cv::v_uint8x16 &a, const cv::v_uint8x16 &b) { return cv::v_min(a, b); }
+#endif
+};
+
+struct MaxOp {
+  enum { NEUTRAL = 0 };
+  static uchar apply(uchar a, uchar b) { return std::max(a, b); }
+#if CV_SIMD128
+  static cv::v_uint8x16 apply(const cv::v_uint8x16 &a, const cv::v_uint8x16 &b) { return cv::v_max(a, b); }
+#endif
+};
+//----------------------------------------------------------------------------
+// out = op(a, b) over n values
+template <typename Op>
+static void combine(const uchar *a, const uchar *b, uchar *out, int n)
+{
+  int x = 0;
+#if CV_SIMD128
+  for (; x <= n - 16; x += 16) {
+    cv::v_store(out + x, Op::apply(cv::v_load(a + x), cv::v_load(b + x)));
+  }
+#endif
+  for (; x < n; x++) {
+    out[x] = Op::apply(a[x], b[x]);
+  }
+}
+//----------------------------------------------------------------------------
+// van Herk/Gil-Werman along the rows: the padded row is cut into blocks of
+// the window size w, g is the running op from the start of each block and h
+// from its end, and the window starting at x is op(h[x], g[x + w - 1]).
+// Three operations per pixel whatever the size of the window.
+template <typename Op>
+class VhgwRowBody : public cv::ParallelLoopBody {
+public:
+  VhgwRowBody(const cv::Mat &src, cv::Mat &dst, int radius)
+    : src(src), dst(dst), radius(radius) {}
+
+  void operator()(const cv::Range &range) const override
+  {
+    int r     = this->radius;
+    int w     = 2*r + 1;
+    int width = this->src.cols;
+    int n     = width + 2*r;
+    std::vector<uchar> ext(n, static_cast<uchar>(Op::NEUTRAL)), g(n), h(n);
+    for (int y = range.start; y < range.end; y++) {
+      std::memcpy(ext.data() + r, this->src.ptr<uchar>(y), width);
+      for (int b = 0; b < n; b += w) {
+        int end = std::min(b + w, n);
+        g[b] = ext[b];
+        for (int i = b + 1; i < end; i++) {
+          g[i] = Op::apply(g[i - 1], ext[i]);
+        }
+        h[end - 1] = ext[end - 1];
+        for (int i = end - 2; i >= b; i--) {
+          h[i] = Op::apply(h[i + 1], ext[i]);
+        }
+      }
+      combine<Op>(h.data(), g.data() + w - 1, this->dst.ptr<uchar>(y), width);
+    }
+  }
+
+private:
+  const cv::Mat &src;
+  cv::Mat       &dst;
+  int            radius;
+};
+//----------------------------------------------------------------------------
+// The same along the columns, on whole rows at a time so that every step is
+// a vector op over the width. Each stripe of output rows reads radius rows
+// above and below it.
+template <typename Op>
+class VhgwColumnBody : public cv::ParallelLoopBody {
+public:
+  VhgwColumnBody(const cv::Mat &src, cv::Mat &dst, int radius, int stripeRows)
+    : src(src), dst(dst), radius(radius), stripeRows(stripeRows) {}
+
+  void operator()(const cv::Range &range) const override
+  {
+    int r     = this->radius;
+    int w     = 2*r + 1;
+    int width = this->src.cols;
+    std::vector<uchar> neutral(width, static_cast<uchar>(Op::NEUTRAL));
+    std::vector<uchar> g, h;
+    for (int stripe = range.start; stripe < range.end; stripe++) {
+      int y0 = stripe*this->stripeRows;
+      int y1 = std::min(y0 + this->stripeRows, this->src.rows);
+      int n  = (y1 - y0) + 2*r;
+      g.resize(static_cast<std::size_t>(n)*width);
+      h.resize(static_cast<std::size_t>(n)*width);
+      auto row = [&](int i) -> const uchar * {
+        int y = y0 - r + i;
+        return (y < 0 || y >= this->src.rows) ? neutral.data() : this->src.ptr<uchar>(y);
+      };
+      for (int b = 0; b < n; b += w) {
+        int end = std::min(b + w, n);
+        std::memcpy(&g[b*width], row(b), width);
+        for (int i = b + 1; i < end; i++) {
+          combine<Op>(&g[(i - 1)*width], row(i), &g[i*width], width);
+        }
+        std::memcpy(&h[(end - 1)*width], row(end - 1), width);
+        for (int i = end - 2; i >= b; i--) {
+          combine<Op>(&h[(i + 1)*width], row(i), &h[i*width], width);
+        }
+      }
+      for (int y = y0; y < y1; y++) {
+        int i = y - y0;
+        combine<Op>(&h[i*width], &g[(i + w - 1)*width], this->dst.ptr<uchar>(y), width);
+      }
+    }
+  }
+
+private:
+  const cv::Mat &src;
+  cv::Mat       &dst;
+  int            radius;
+  int            stripeRows;
+};
+//----------------------------------------------------------------------------
+template <typename Op>
+static void vhgwFilter(const cv::Mat &src, cv::Mat &dst, int iterations)
+{
+  CV_Assert(src.type() == CV_8UC1);
+  if (iterations <= 0 || src.empty()) {
+    if (dst.data != src.data) src.copyTo(dst);
+    return;
+  }
+  // rows first into a temporary, then the columns into dst, so that dst may
+  // be src
+  cv::Mat rowsDone(src.size(), CV_8UC1);
+  VhgwRowBody<Op> rowBody(src, rowsDone, iterations);
+  cv::parallel_for_(cv::Range(0, src.rows), rowBody, src.rows/32.0);
+
+  dst.create(src.size(), CV_8UC1);
+  // a couple of stripes per thread, tall compared to the window
+  int stripes = std::max(1, std::min(src.rows/std::max(32, 2*iterations + 1),
+                                     2*cv::getNumThreads()));
+  int stripeRows = (src.rows + stripes - 1)/stripes;
+  stripes = (src.rows + stripeRows - 1)/stripeRows;
+  VhgwColumnBody<Op> columnBody(rowsDone, dst, iterations, stripeRows);
+  cv::parallel_for_(cv::Range(0, stripes), columnBody, stripes);
+}
+//----------------------------------------------------------------------------
+void vhgwErode(const cv::Mat &src, cv::Mat &dst, int iterations)
+{
+  vhgwFilter<MinOp>(src, dst, iterations);
+}
+//----------------------------------------------------------------------------
+void vhgwDilate(const cv::Mat &src, cv::Mat &dst, int iterations)
+{
+  vhgwFilter<MaxOp>(src, dst, iterations);
+}
@@ -0,0 +1,47 @@
+#ifndef MORPHOLOGY_H
+#define MORPHOLOGY_H
+
+#include "opencv2/core/core.hpp"
+//
+#include <string>
+
+//
+// How the erode/dilate iterations of motion detection are computed: k calls
+// of the 3x3 cv::erode/cv::dilate (OpenCV folds them into one (2k+1) sized
+// rectangle, O(k) per pixel), the van Herk/Gil-Werman min/max filter over
+// the same rectangle (O(1) per pixel), or both with the results compared.
+//
+enum class MorphologyMethod : int
+{
+    opencv  = 0,
+    vhgw    = 1,
+    compare = 2,
+};
+
+inline bool parseMorphologyMethod(const std::string &name, MorphologyMethod &method) {
+  if (name == "opencv") method = MorphologyMethod::opencv;
+  else if (name == "vhgw") method = MorphologyMethod::vhgw;
+  else if (name == "compare") method = MorphologyMethod::compare;
+  else return false;
+  return true;
+}
+
+inline const char *morphologyMethodName(MorphologyMethod method) {
+  switch (method) {
+    case MorphologyMethod::opencv:  return "opencv";
+    case MorphologyMethod::vhgw:    return "vhgw";
+    case MorphologyMethod::compare: return "compare";
+  }
+  return "unknown";
+}
+
+//
+// iterations times the 3x3 erosion (dilation) of cv::erode (cv::dilate) with
+// the default kernel and border, as one van Herk/Gil-Werman pass over rows
+// and one over columns, both split into stripes for cv::parallel_for_.
+// CV_8UC1 only, src and dst may be the same image.
+//
+void vhgwErode(const cv::Mat &src, cv::Mat &dst, int iterations);
+void vhgwDilate(const cv::Mat &src, cv::Mat &dst, int iterations);
+
+#endif
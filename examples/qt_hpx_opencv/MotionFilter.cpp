@@ -1,19 +1,24 @@
 #include "filter.hpp"
 #include "MotionFilter.hpp"
+#include "FramePool.hpp"
+#include "OverlayCompositor.hpp"
 //
 #include <opencv2/core/core.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
 #include "opencv2/videoio/videoio_c.h"
 #include "opencv2/imgproc/imgproc_c.h"
+#include <opencv2/core/hal/intrin.hpp>
 //
-#include <QDateTime>
-#include <QString>
-//
-boost::accumulators::accumulator_set<int, boost::accumulators::stats<boost::accumulators::tag::rolling_mean> >
-  acc(boost::accumulators::tag::rolling_window::window_size = 10);
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <string>
 //
 //----------------------------------------------------------------------------
 MotionFilter::MotionFilter()
+  : motionHistory(boost::accumulators::tag::rolling_window::window_size = 10)
 {
   this->imageSize         = cv::Size(-1,-1);
   //
@@ -34,9 +39,26 @@ MotionFilter::MotionFilter()
   this->eventLevel       = 0.0;
   //
   this->frameCount = 0;
+  this->kernel = MotionKernel::opencv;
+  this->backgroundModel = BackgroundModel::float32;
+  this->lumaOnly = false;
+  this->pyramidScale = 0;
+  this->tilesRefined = 0;
+  this->tilesTotal = 0;
+  this->skipLevel = 0.0;
+  this->blocksSkipped = 0;
+  this->blocksTotal = 0;
+  this->kernelMismatches = 0;
+  this->trackBlobs = false;
+  this->trackedBlobs = 0;
+  this->morphologyMethod = MorphologyMethod::opencv;
+  this->morphologyMismatches = 0;
+  this->morphologyTime_ms = 0.0;
 }
 
-MotionFilter::MotionFilter(MotionFilterParams mfp){
+MotionFilter::MotionFilter(MotionFilterParams mfp)
+  : motionHistory(boost::accumulators::tag::rolling_window::window_size = 10)
+{
   this->imageSize         = cv::Size(-1,-1);
   //
   this->renderer          = NULL;
@@ -56,6 +78,21 @@ MotionFilter::MotionFilter(MotionFilterParams mfp){
   this->eventLevel       = 0.0;
   //
   this->frameCount = 0;
+  this->kernel = MotionKernel::opencv;
+  this->backgroundModel = BackgroundModel::float32;
+  this->lumaOnly = false;
+  this->pyramidScale = 0;
+  this->tilesRefined = 0;
+  this->tilesTotal = 0;
+  this->skipLevel = 0.0;
+  this->blocksSkipped = 0;
+  this->blocksTotal = 0;
+  this->kernelMismatches = 0;
+  this->trackBlobs = false;
+  this->trackedBlobs = 0;
+  this->morphologyMethod = MorphologyMethod::opencv;
+  this->morphologyMismatches = 0;
+  this->morphologyTime_ms = 0.0;
 }
 //----------------------------------------------------------------------------
 MotionFilter::~MotionFilter()
@@ -71,18 +108,37 @@ void MotionFilter::DeleteTemporaryStorage()
   this->blendImage.release();
   this->difference.release();
   this->floatImage.release();
+  this->fusedAverage.release();
+  this->fixedAverage.release();
+  this->coarseAverage.release();
+  this->coarseLast.release();
+  this->rawThreshold.release();
+  this->tileUpdated.clear();
+  this->blocks.cols = 0;
+  this->blocks.rows = 0;
+  this->fusedMask.release();
+  this->blobTracker.reset();
 }
 //----------------------------------------------------------------------------
 void MotionFilter::process(const cv::Mat &image)
 {
-  if (this->lastFrame.empty() || image.size()!=this->lastFrame.size()) {
+  // in luma mode the detection works on grey frames, converted once here;
+  // the colour image is only used for display
+  cv::Mat input = image;
+  if (this->lumaOnly && image.channels()==3) {
+    input = FramePool::instance().create(image.size(), CV_8UC1);
+    cv::cvtColor(image, input, CV_RGB2GRAY);
+  }
+  if (this->lastFrame.empty() || input.size()!=this->lastFrame.size() ||
+      input.type()!=this->lastFrame.type()) {
 
   }
   else {
-    cv::Mat currentFrame = image;
-    cv::Size workingSize = image.size();
+    cv::Mat currentFrame = input;
+    cv::Size workingSize = input.size();
     if (workingSize.width!=this->imageSize.width ||
-      workingSize.height!=this->imageSize.height)
+      workingSize.height!=this->imageSize.height ||
+      (!this->difference.empty() && this->difference.channels()!=input.channels()))
     {
       this->DeleteTemporaryStorage();
       this->imageSize = workingSize;
@@ -91,79 +147,157 @@ void MotionFilter::process(const cv::Mat &image)
     // allocate image arrays, only executed on first pass (or size change)
     //
     if (this->difference.empty()) {
-      //
-      this->movingAverage   = cv::Mat( workingSize, CV_32FC3);
+      // one channel per channel of the input, the blend image is created
+      // when it is displayed
+      int cn = input.channels();
+      this->movingAverage   = cv::Mat( workingSize, CV_32FC(cn));
       this->greyScaleImage  = cv::Mat( workingSize, CV_8UC1);
       this->thresholdImage  = cv::Mat( workingSize, CV_8UC1);
-      this->blendImage      = cv::Mat( workingSize, CV_8UC3);
-      this->floatImage      = cv::Mat( workingSize, CV_8UC3);
-      this->difference      = cv::Mat( workingSize, CV_8UC3);
+      this->floatImage      = cv::Mat( workingSize, CV_8UC(cn));
+      this->difference      = cv::Mat( workingSize, CV_8UC(cn));
       //
       currentFrame.convertTo(this->movingAverage, this->movingAverage.type(), 1.0, 0.0);
+    }
 
-      // initialize font and precompute text size
-      QString timestring = QDateTime::currentDateTime().toString("dd/MM/yyyy hh:mm:ss");
-      this->text_size = cv::getTextSize( timestring.toLatin1().data(), CV_FONT_HERSHEY_PLAIN, 1.0, 1, NULL);
+    // the fused pass handles 8 bit colour or grey frames
+    MotionKernel kernel = (currentFrame.type()==CV_8UC3 || currentFrame.type()==CV_8UC1) ?
+                          this->kernel : MotionKernel::opencv;
+    // the pyramid pass runs the float OpenCV steps whatever the model
+    bool fixedModel = kernel != MotionKernel::opencv && this->pyramidScale <= 1 &&
+                      this->backgroundModel == BackgroundModel::fixed16;
+    if (kernel == MotionKernel::compare && this->fusedMask.empty()) {
+      this->fusedAverage = this->movingAverage.clone();
+      this->fusedMask    = cv::Mat( workingSize, CV_8UC1);
+    }
+    if (fixedModel && this->fixedAverage.empty()) {
+      // continue from the float average, in 1/128 units
+      this->movingAverage.convertTo(this->fixedAverage, CV_16S, 128.0);
     }
 
+    bool morphology = this->erodeIterations>0 || this->dilateIterations>0;
+    bool skipBlocks = kernel == MotionKernel::fused && this->skipLevel>0;
+
     cv::Mat shownImage;
-    if (1) {
-      // add last frame to weighted moving average
-      // if average = 1 we compare this frame to last frame
-      // if average = epsilon, we compare this frame to smoothed average of previous frames
-      cv::accumulateWeighted(this->lastFrame, this->movingAverage, this->average);
+    int fusedNonZero = -1;
+    this->frameCount++;
+    if (this->pyramidScale>1) {
+      fusedNonZero = this->pyramidThreshold(currentFrame);
+    }
+    else {
+      if (kernel != MotionKernel::fused) {
+        // add last frame to weighted moving average
+        // if average = 1 we compare this frame to last frame
+        // if average = epsilon, we compare this frame to smoothed average of previous frames
+        cv::accumulateWeighted(this->lastFrame, this->movingAverage, this->average);
 
-      // Convert the current frame to float for diffing channels
-      // we should leave as uchar, but his if for future use when we do more complex operations
-      this->movingAverage.convertTo(this->floatImage, this->floatImage.type());
+        // Convert the current frame to float for diffing channels
+        // we should leave as uchar, but his if for future use when we do more complex operations
+        this->movingAverage.convertTo(this->floatImage, this->floatImage.type());
 
-//      cv::Mat med2;
-//      cv::medianBlur(this->floatImage, med2, 5);
+//        cv::Mat med2;
+//        cv::medianBlur(this->floatImage, med2, 5);
 
-      // get the difference of this frame from the moving average.
-      cv::absdiff(currentFrame, this->floatImage, this->difference);
+        // get the difference of this frame from the moving average.
+        cv::absdiff(currentFrame, this->floatImage, this->difference);
 
-      // Convert the image to grayscale.
-      cv::cvtColor(this->difference, this->greyScaleImage, CV_RGB2GRAY);
+        // Convert the image to grayscale.
+        cv::Mat grey = this->difference;
+        if (this->difference.channels()==3) {
+          cv::cvtColor(this->difference, this->greyScaleImage, CV_RGB2GRAY);
+          grey = this->greyScaleImage;
+        }
 
-      // Threshold the image to black/white off/on.
-      cv::threshold(this->greyScaleImage, this->thresholdImage, threshold, 255, CV_THRESH_BINARY);
+        // Threshold the image to black/white off/on.
+        cv::threshold(grey, this->thresholdImage, threshold, 255, CV_THRESH_BINARY);
+      }
+      if (kernel != MotionKernel::opencv) {
+        cv::Mat &average = fixedModel ? this->fixedAverage :
+                           kernel == MotionKernel::fused ? this->movingAverage : this->fusedAverage;
+        if (kernel == MotionKernel::fused && skipBlocks) {
+          if (morphology) {
+            if (this->rawThreshold.size()!=workingSize) {
+              this->rawThreshold = cv::Mat( workingSize, CV_8UC1);
+            }
+            this->fusedThreshold(currentFrame, average, this->rawThreshold, true);
+            fusedNonZero = this->blockMorphology();
+          }
+          else {
+            fusedNonZero = this->fusedThreshold(currentFrame, average, this->thresholdImage, true);
+          }
+        }
+        else if (kernel == MotionKernel::fused) {
+          fusedNonZero = this->fusedThreshold(currentFrame, average, this->thresholdImage);
+        }
+        else {
+          this->fusedThreshold(currentFrame, average, this->fusedMask);
+          this->kernelMismatches += cv::countNonZero(this->thresholdImage != this->fusedMask);
+        }
+      }
 
       // Erode and Dilate to denoise and produce blobs
-      if (this->erodeIterations>0) {
-        cv::erode(this->thresholdImage, this->thresholdImage, cv::Mat(), cv::Point(-1,-1), this->erodeIterations);
-      }
-      if (this->dilateIterations>0) {
-        cv::dilate(this->thresholdImage, this->thresholdImage, cv::Mat(), cv::Point(-1,-1), this->dilateIterations);
+      if (morphology && !skipBlocks) {
+        this->erodeDilate(this->thresholdImage);
       }
+    }
 
-      // Convert the image to grayscale.
-      cv::cvtColor(this->thresholdImage, this->blendImage, CV_GRAY2BGR);
+    if (this->trackBlobs) {
+      this->trackedBlobs = static_cast<int>(this->blobTracker.process(this->thresholdImage).size());
+    }
 
+    //
+    // Image passed to the GUI, made only when there is one
+    //
+    if (this->renderer) {
       switch (this->displayImage) {
         case 0:
-          shownImage = currentFrame;
+          if (input.data == image.data) {
+            // the input becomes lastFrame, the boxes and the time stamp
+            // would be detected as motion in the next frame
+            shownImage = FramePool::instance().create(image.size(), image.type());
+            image.copyTo(shownImage);
+          }
+          else {
+            shownImage = image;
+          }
           break;
         case 1:
-          shownImage = this->movingAverage;
+          if (fixedModel && kernel == MotionKernel::fused) {
+            this->fixedAverage.convertTo(this->floatImage, this->floatImage.type(), 1.0/128.0);
+            shownImage = this->floatImage;
+          }
+          else {
+            shownImage = this->movingAverage;
+          }
           break;
         case 2:
-          shownImage = this->thresholdImage;
+          if (this->trackBlobs) {
+            // in colour for the blob boxes, the threshold image is kept
+            cv::cvtColor(this->thresholdImage, this->blendImage, CV_GRAY2BGR);
+            shownImage = this->blendImage;
+          }
+          else {
+            shownImage = this->thresholdImage;
+          }
           break;
         default:
         case 3:
+          cv::cvtColor(this->thresholdImage, this->blendImage, CV_GRAY2BGR);
           /* dst = src1 * alpha + src2 * beta + gamma */
-          cv::addWeighted(currentFrame, this->blendRatio, this->blendImage, 1.0-this->blendRatio, 0.0, this->blendImage);
+          cv::addWeighted(image, this->blendRatio, this->blendImage, 1.0-this->blendRatio, 0.0, this->blendImage);
           shownImage = this->blendImage;
           break;
         case 4:
-          cv::bitwise_or(currentFrame, this->blendImage, this->blendImage);
+          cv::cvtColor(this->thresholdImage, this->blendImage, CV_GRAY2BGR);
+          cv::bitwise_or(image, this->blendImage, this->blendImage);
           shownImage = this->blendImage;
           break;
       }
     }
 
-    double nonzero = cv::countNonZero(this->thresholdImage);
+    // erosion and dilation change the count of the fused pass, the pyramid
+    // and block skipping passes count after them
+    double nonzero = (fusedNonZero>=0 && (this->pyramidScale>1 || skipBlocks || !morphology)) ?
+                     fusedNonZero : cv::countNonZero(this->thresholdImage);
     double pixels = this->thresholdImage.total();
     // max 1, min 0
     this->motionEstimate = nonzero/pixels;
@@ -174,29 +308,491 @@ void MotionFilter::process(const cv::Mat &image)
     this->logMotion = (this->logMotion>54.0) ? 54.0 : this->logMotion;
     this->logMotion = 100.0*(54.0-this->logMotion)/54.0;
     //
-    this->normalizedMotion = (this->normalizedMotion>100.0) ? 100.0 : this->normalizedMotion;
+    this->normalizedMotion = (this->logMotion>100.0) ? 100.0 : this->logMotion;
 
-    acc(this->normalizedMotion);
-    this->rollingMean = boost::accumulators::rolling_mean(acc);
+    this->motionHistory(this->normalizedMotion);
+    this->rollingMean = boost::accumulators::rolling_mean(this->motionHistory);
     //
     this->eventLevel = (rollingMean>this->triggerLevel) ? 100 : 0;
 
-    //
-    // Add time and data to image
-    //
-    QString timestring = QDateTime::currentDateTime().toString("dd/MM/yyyy hh:mm:ss");
-    cv::putText(shownImage, timestring.toLatin1().data(),
-      cvPoint(shownImage.size().width - text_size.width - 4, text_size.height+4),
-      CV_FONT_HERSHEY_PLAIN, 1.0, cv::Scalar(255, 255, 255, 0), 1);
-    //
-    // Pass final image to GUI
-    //
     if (renderer) {
+      //
+      // Boxes and track numbers of the blobs, not drawn into the average
+      //
+      if (this->trackBlobs && this->displayImage!=1) {
+        for (const Blob &blob : this->blobTracker.blobs) {
+          cv::rectangle(shownImage, blob.box, cv::Scalar(0, 255, 0), 1);
+          OverlayCompositor::instance().caption(shownImage, std::to_string(blob.id),
+            blob.box.tl() + cv::Point(2, 12), cv::Scalar(0, 255, 0));
+        }
+      }
+      //
+      // Add time and data to image
+      //
+      OverlayCompositor::instance().timestamp(shownImage);
+      //
+      // Pass final image to GUI
+      //
       renderer->process(shownImage);
     }
   }
   //
-  this->lastFrame = image;
+  this->lastFrame = input;
+}
+//----------------------------------------------------------------------------
+// One row of the fused pass, n = width*channels values:
+//   average    = last*alpha + average*beta     (cv::accumulateWeighted)
+//   difference = |current - round(average)|    (convertTo + cv::absdiff)
+// using the same float expression and rounding as OpenCV.
+static void accumulateAndDiff(const uchar *current, const uchar *last, float *average,
+                              uchar *difference, int n, float alpha)
+{
+  float beta = 1.0f - alpha;
+  int x = 0;
+#if CV_SIMD128
+  cv::v_float32x4 va = cv::v_setall_f32(alpha), vb = cv::v_setall_f32(beta);
+  for (; x <= n - 16; x += 16) {
+    cv::v_uint16x8 l0, l1;
+    cv::v_uint32x4 l00, l01, l10, l11;
+    cv::v_expand(cv::v_load(last + x), l0, l1);
+    cv::v_expand(l0, l00, l01);
+    cv::v_expand(l1, l10, l11);
+    cv::v_float32x4 a0 = cv::v_cvt_f32(cv::v_reinterpret_as_s32(l00))*va + cv::v_load(average + x)*vb;
+    cv::v_float32x4 a1 = cv::v_cvt_f32(cv::v_reinterpret_as_s32(l01))*va + cv::v_load(average + x + 4)*vb;
+    cv::v_float32x4 a2 = cv::v_cvt_f32(cv::v_reinterpret_as_s32(l10))*va + cv::v_load(average + x + 8)*vb;
+    cv::v_float32x4 a3 = cv::v_cvt_f32(cv::v_reinterpret_as_s32(l11))*va + cv::v_load(average + x + 12)*vb;
+    cv::v_store(average + x, a0);
+    cv::v_store(average + x + 4, a1);
+    cv::v_store(average + x + 8, a2);
+    cv::v_store(average + x + 12, a3);
+    cv::v_uint8x16 rounded = cv::v_pack_u(cv::v_pack(cv::v_round(a0), cv::v_round(a1)),
+                                          cv::v_pack(cv::v_round(a2), cv::v_round(a3)));
+    cv::v_store(difference + x, cv::v_absdiff(cv::v_load(current + x), rounded));
+  }
+#endif
+  for (; x < n; x++) {
+    float a = last[x]*alpha + average[x]*beta;
+    average[x] = a;
+    uchar rounded = cv::saturate_cast<uchar>(a);
+    difference[x] = current[x] > rounded ? current[x] - rounded : rounded - current[x];
+  }
+}
+//----------------------------------------------------------------------------
+// The same with the fixed point average, in 1/128 units (at most 255*128, so
+// the average and its difference to a new value fit in 16 bits):
+//   average    += ((last*128 - average)*alpha + 1/2) >> 15    alpha in 1/32768
+//   difference  = |current - (average + 64) >> 7|
+// The learning rate is alpha to 1/32768; the average settles within 0.5/alpha
+// units (0.4 grey levels at alpha=0.01) of a constant input instead of
+// converging to it.
+static void accumulateAndDiff(const uchar *current, const uchar *last, short *average,
+                              uchar *difference, int n, float alpha)
+{
+  int a = std::min(cvRound(alpha*32768), 32767);
+  int x = 0;
+#if CV_SIMD128
+  cv::v_int16x8 va = cv::v_setall_s16(static_cast<short>(a));
+  cv::v_int16x8 v64 = cv::v_setall_s16(64);
+  cv::v_int32x4 half = cv::v_setall_s32(1 << 14);
+  for (; x <= n - 16; x += 16) {
+    cv::v_uint16x8 l0, l1;
+    cv::v_int32x4 p0, p1, p2, p3;
+    cv::v_expand(cv::v_load(last + x), l0, l1);
+    cv::v_int16x8 a0 = cv::v_load(average + x);
+    cv::v_int16x8 a1 = cv::v_load(average + x + 8);
+    cv::v_mul_expand(cv::v_reinterpret_as_s16(l0 << 7) - a0, va, p0, p1);
+    cv::v_mul_expand(cv::v_reinterpret_as_s16(l1 << 7) - a1, va, p2, p3);
+    a0 = a0 + cv::v_pack((p0 + half) >> 15, (p1 + half) >> 15);
+    a1 = a1 + cv::v_pack((p2 + half) >> 15, (p3 + half) >> 15);
+    cv::v_store(average + x, a0);
+    cv::v_store(average + x + 8, a1);
+    cv::v_uint8x16 rounded = cv::v_pack(cv::v_reinterpret_as_u16((a0 + v64) >> 7),
+                                        cv::v_reinterpret_as_u16((a1 + v64) >> 7));
+    cv::v_store(difference + x, cv::v_absdiff(cv::v_load(current + x), rounded));
+  }
+#endif
+  for (; x < n; x++) {
+    int avg = average[x];
+    avg += (((last[x] << 7) - avg)*a + (1 << 14)) >> 15;
+    average[x] = static_cast<short>(avg);
+    int rounded = (avg + 64) >> 7;
+    difference[x] = static_cast<uchar>(std::abs(current[x] - rounded));
+  }
+}
+//----------------------------------------------------------------------------
+// Sum of absolute differences of n values
+static int rowSAD(const uchar *a, const uchar *b, int n)
+{
+  int x = 0, sum = 0;
+#if CV_SIMD128
+  // n is at most one block row, the 16 bit sums do not overflow
+  cv::v_uint16x8 s0 = cv::v_setzero_u16(), s1 = cv::v_setzero_u16();
+  for (; x <= n - 16; x += 16) {
+    cv::v_uint16x8 d0, d1;
+    cv::v_expand(cv::v_absdiff(cv::v_load(a + x), cv::v_load(b + x)), d0, d1);
+    s0 += d0;
+    s1 += d1;
+  }
+  cv::v_uint32x4 w0, w1, w2, w3;
+  cv::v_expand(s0, w0, w1);
+  cv::v_expand(s1, w2, w3);
+  sum = cv::v_reduce_sum(w0 + w1 + w2 + w3);
+#endif
+  for (; x < n; x++) {
+    sum += std::abs(a[x] - b[x]);
+  }
+  return sum;
+}
+//----------------------------------------------------------------------------
+// Runs the fused pass over tiles of rows, small enough that the difference
+// and the grey values stay in cache between the steps; the full size
+// intermediate images are never written. T is the element type of the
+// average, float or fixed point short.
+//
+// With blocks the tiles are one row of MotionBlocks::SIZE square blocks. A
+// block which differs little from the last frame and had no motion when it
+// was last processed is skipped: its average is not updated and its mask is
+// zero. When it is processed again its average catches up on the frames it
+// missed, assuming it saw the last frame in each of them.
+template <typename T>
+class FusedMotionBody : public cv::ParallelLoopBody {
+public:
+  FusedMotionBody(const cv::Mat &current, const cv::Mat &last, cv::Mat &average, cv::Mat &mask,
+                  double alpha, int threshold, int tileRows, MotionBlocks *blocks,
+                  std::atomic<int> &nonzero)
+    : current(current), last(last), average(average), mask(mask),
+      alpha(alpha), threshold(threshold), tileRows(tileRows), blocks(blocks), nonzero(nonzero) {}
+
+  void operator()(const cv::Range &range) const override
+  {
+    int width = this->current.cols;
+    int cn    = this->current.channels();
+    int n     = width*cn;
+    cv::Mat difference(this->tileRows, width, CV_8UC(cn));
+    cv::Mat grey(this->tileRows, width, CV_8UC1);
+    int blockSize = MotionBlocks::SIZE;
+    int blockCols = this->blocks ? this->blocks->cols : 0;
+    std::vector<float> blockAlpha(blockCols);
+    std::vector<uchar> blockProcessed(blockCols);
+    std::vector<int> blockSums(blockCols);
+    int count = 0, skipped = 0;
+    for (int tile = range.start; tile < range.end; tile++) {
+      int y0   = tile*this->tileRows;
+      int rows = std::min(this->tileRows, this->current.rows - y0);
+      if (this->blocks) {
+        // which blocks of this row of blocks are processed, and their alpha
+        std::fill(blockSums.begin(), blockSums.end(), 0);
+        for (int r = 0; r < rows; r++) {
+          const uchar *c = this->current.ptr<uchar>(y0 + r);
+          const uchar *l = this->last.ptr<uchar>(y0 + r);
+          for (int b = 0; b < blockCols; b++) {
+            int x0 = b*blockSize*cn;
+            blockSums[b] += rowSAD(c + x0, l + x0, std::min(blockSize*cn, n - x0));
+          }
+        }
+        for (int b = 0; b < blockCols; b++) {
+          int index  = tile*blockCols + b;
+          int missed = this->blocks->frame - 1 - this->blocks->updated[index];
+          if (blockSums[b] <= this->blocks->sadLimit && !this->blocks->motion[index] &&
+              missed < MotionBlocks::MAX_SKIPPED) {
+            blockProcessed[b] = 0;
+            skipped++;
+          }
+          else {
+            blockProcessed[b] = 1;
+            blockAlpha[b] = static_cast<float>(1.0 - std::pow(1.0 - this->alpha, missed + 1));
+            this->blocks->updated[index] = this->blocks->frame;
+            this->blocks->motion[index]  = 0;
+          }
+        }
+      }
+      for (int r = 0; r < rows; r++) {
+        const uchar *c = this->current.ptr<uchar>(y0 + r);
+        const uchar *l = this->last.ptr<uchar>(y0 + r);
+        T           *a = this->average.template ptr<T>(y0 + r);
+        uchar       *d = difference.ptr<uchar>(r);
+        if (!this->blocks) {
+          accumulateAndDiff(c, l, a, d, n, static_cast<float>(this->alpha));
+          continue;
+        }
+        for (int b = 0; b < blockCols; b++) {
+          int x0 = b*blockSize*cn;
+          int nb = std::min(blockSize*cn, n - x0);
+          if (blockProcessed[b]) {
+            accumulateAndDiff(c + x0, l + x0, a + x0, d + x0, nb, blockAlpha[b]);
+          }
+          else {
+            std::fill(d + x0, d + x0 + nb, 0);
+          }
+        }
+      }
+      // the grey conversion is left to OpenCV on the tile, its fixed point
+      // coefficients differ between versions
+      cv::Mat differenceTile = difference.rowRange(0, rows);
+      cv::Mat greyTile = grey.rowRange(0, rows);
+      if (cn==3) {
+        cv::cvtColor(differenceTile, greyTile, CV_RGB2GRAY);
+      }
+      else {
+        greyTile = differenceTile;
+      }
+      // cv::threshold(..., CV_THRESH_BINARY) and cv::countNonZero
+      for (int r = 0; r < rows; r++) {
+        const uchar *g = greyTile.ptr<uchar>(r);
+        uchar *m = this->mask.ptr<uchar>(y0 + r);
+        int rowCount = 0;
+        for (int x = 0; x < width; x++) {
+          int on = g[x] > this->threshold;
+          m[x] = on ? 255 : 0;
+          rowCount += on;
+        }
+        if (this->blocks && rowCount>0) {
+          for (int x = 0; x < width; x++) {
+            if (m[x]) this->blocks->motion[tile*blockCols + x/blockSize] = 1;
+          }
+        }
+        count += rowCount;
+      }
+    }
+    this->nonzero += count;
+    if (this->blocks) {
+      this->blocks->skipped += skipped;
+    }
+  }
+
+private:
+  const cv::Mat    &current;
+  const cv::Mat    &last;
+  cv::Mat          &average;
+  cv::Mat          &mask;
+  double            alpha;
+  int               threshold;
+  int               tileRows;
+  MotionBlocks     *blocks;
+  std::atomic<int> &nonzero;
+};
+//----------------------------------------------------------------------------
+int MotionFilter::fusedThreshold(const cv::Mat &image, cv::Mat &average, cv::Mat &mask, bool skipBlocks)
+{
+  std::atomic<int> nonzero(0);
+  MotionBlocks *blocks = nullptr;
+  int tileRows = std::max(1, (32*1024) / (image.cols*image.channels()));
+  if (skipBlocks) {
+    blocks   = &this->blocks;
+    tileRows = MotionBlocks::SIZE;
+    int cols = (image.cols + MotionBlocks::SIZE - 1)/MotionBlocks::SIZE;
+    int rows = (image.rows + MotionBlocks::SIZE - 1)/MotionBlocks::SIZE;
+    if (blocks->cols!=cols || blocks->rows!=rows) {
+      blocks->cols = cols;
+      blocks->rows = rows;
+      blocks->motion.assign(cols*rows, 0);
+      blocks->updated.assign(cols*rows, this->frameCount - 1);
+    }
+    // mean absolute difference per value
+    blocks->sadLimit = static_cast<int>(this->skipLevel*MotionBlocks::SIZE*MotionBlocks::SIZE*image.channels());
+    blocks->frame    = this->frameCount;
+    blocks->skipped  = 0;
+  }
+  int tiles = (image.rows + tileRows - 1)/tileRows;
+  // bands of about 64 rows
+  if (average.depth() == CV_16S) {
+    FusedMotionBody<short> body(image, this->lastFrame, average, mask, this->average, this->threshold,
+                                tileRows, blocks, nonzero);
+    cv::parallel_for_(cv::Range(0, tiles), body, image.rows/64.0);
+  }
+  else {
+    FusedMotionBody<float> body(image, this->lastFrame, average, mask, this->average, this->threshold,
+                                tileRows, blocks, nonzero);
+    cv::parallel_for_(cv::Range(0, tiles), body, image.rows/64.0);
+  }
+  if (blocks) {
+    this->blocksSkipped += blocks->skipped;
+    this->blocksTotal   += blocks->cols*blocks->rows;
+  }
+  return nonzero;
+}
+//----------------------------------------------------------------------------
+// Erode and dilate of the threshold image limited to the rows of blocks with
+// motion and the rows the dilation reaches from them; the other rows have no
+// motion. Reads rawThreshold, writes thresholdImage, returns its non zero
+// pixels.
+int MotionFilter::blockMorphology()
+{
+  int rows   = this->rawThreshold.rows;
+  int reach  = this->dilateIterations;
+  int margin = this->erodeIterations + this->dilateIterations;
+  // rows of the output which can be non zero
+  std::vector<uchar> outputRows(rows, 0);
+  for (int by = 0; by < this->blocks.rows; by++) {
+    bool active = false;
+    for (int bx = 0; bx < this->blocks.cols && !active; bx++) {
+      active = this->blocks.motion[by*this->blocks.cols + bx]!=0;
+    }
+    if (!active) continue;
+    int y0 = std::max(0, by*MotionBlocks::SIZE - reach);
+    int y1 = std::min(rows, (by + 1)*MotionBlocks::SIZE + reach);
+    std::fill(outputRows.begin() + y0, outputRows.begin() + y1, 1);
+  }
+  //
+  this->thresholdImage.setTo(0);
+  int nonzero = 0;
+  for (int y = 0; y < rows; ) {
+    if (!outputRows[y]) { y++; continue; }
+    int y1 = y;
+    while (y1 < rows && outputRows[y1]) y1++;
+    int i0 = std::max(0, y - margin);
+    int i1 = std::min(rows, y1 + margin);
+    cv::Mat blobs;
+    this->rawThreshold.rowRange(i0, i1).copyTo(blobs);
+    this->erodeDilate(blobs);
+    cv::Mat band = this->thresholdImage.rowRange(y, y1);
+    blobs.rowRange(y - i0, y1 - i0).copyTo(band);
+    nonzero += cv::countNonZero(band);
+    y = y1;
+  }
+  return nonzero;
+}
+//----------------------------------------------------------------------------
+// The whole pipeline runs on the frame downscaled by pyramidScale, the tiles
+// (16x16 coarse pixels) with thresholded pixels are then processed with the
+// same OpenCV steps as the full frame path. Erode and dilate of a tile read
+// rawThreshold up to erodeIterations+dilateIterations pixels around it, so
+// the neighbouring tiles are brought up to date too and the result inside
+// the tile is the one of the full frame path. Moving objects smaller than a
+// coarse pixel which change it by less than the threshold are not seen.
+int MotionFilter::pyramidThreshold(const cv::Mat &image)
+{
+  int scale    = this->pyramidScale;
+  int tileSize = 16*scale;
+  int margin   = this->erodeIterations + this->dilateIterations;
+  int tilesX   = (image.cols + tileSize - 1)/tileSize;
+  int tilesY   = (image.rows + tileSize - 1)/tileSize;
+  cv::Rect frameRect(0, 0, image.cols, image.rows);
+  //
+  cv::Mat coarse;
+  cv::resize(image, coarse, cv::Size(image.cols/scale, image.rows/scale), 0, 0, cv::INTER_AREA);
+  if (this->coarseAverage.size()!=coarse.size() ||
+      this->coarseAverage.channels()!=coarse.channels() ||
+      this->tileUpdated.size()!=static_cast<size_t>(tilesX*tilesY))
+  {
+    coarse.convertTo(this->coarseAverage, CV_32F);
+    this->coarseLast   = coarse;
+    this->rawThreshold = cv::Mat::zeros(image.size(), CV_8UC1);
+    this->tileUpdated.assign(tilesX*tilesY, this->frameCount - 1);
+  }
+  //
+  // coarse pass
+  //
+  cv::Mat coarseRounded, coarseDifference, coarseMask;
+  cv::accumulateWeighted(this->coarseLast, this->coarseAverage, this->average);
+  this->coarseAverage.convertTo(coarseRounded, coarse.type());
+  cv::absdiff(coarse, coarseRounded, coarseDifference);
+  if (coarseDifference.channels()==3) {
+    cv::cvtColor(coarseDifference, coarseDifference, CV_RGB2GRAY);
+  }
+  cv::threshold(coarseDifference, coarseMask, threshold, 255, CV_THRESH_BINARY);
+  // activity on a tile border may continue in the neighbour
+  cv::dilate(coarseMask, coarseMask, cv::Mat());
+  this->coarseLast = coarse;
+  //
+  // tiles with activity, and those their erode/dilate reads
+  //
+  std::vector<uchar> refined(tilesX*tilesY, 0), updated(tilesX*tilesY, 0);
+  cv::Rect coarseRect(0, 0, coarse.cols, coarse.rows);
+  int refinedCount = 0;
+  for (int ty = 0; ty < tilesY; ty++) {
+    for (int tx = 0; tx < tilesX; tx++) {
+      cv::Rect r = cv::Rect(tx*16, ty*16, 16, 16) & coarseRect;
+      if (r.area()>0 && cv::countNonZero(coarseMask(r))>0) {
+        refined[ty*tilesX + tx] = 1;
+        refinedCount++;
+        int n = (margin>0) ? 1 : 0;
+        for (int y = std::max(0, ty - n); y <= std::min(tilesY - 1, ty + n); y++) {
+          for (int x = std::max(0, tx - n); x <= std::min(tilesX - 1, tx + n); x++) {
+            updated[y*tilesX + x] = 1;
+          }
+        }
+      }
+    }
+  }
+  this->tilesRefined += refinedCount;
+  this->tilesTotal   += tilesX*tilesY;
+  //
+  // full resolution steps of the full frame path, per tile
+  //
+  for (int i = 0; i < tilesX*tilesY; i++) {
+    if (!updated[i]) continue;
+    cv::Rect r = cv::Rect((i % tilesX)*tileSize, (i / tilesX)*tileSize, tileSize, tileSize) & frameRect;
+    // the tile missed the updates of the frames it was skipped in, in which
+    // (nothing having moved) it saw about the last frame
+    int missed = this->frameCount - 1 - this->tileUpdated[i];
+    double alpha = 1.0 - std::pow(1.0 - this->average, missed + 1);
+    this->tileUpdated[i] = this->frameCount;
+    //
+    cv::Mat averageTile    = this->movingAverage(r);
+    cv::Mat roundedTile    = this->floatImage(r);
+    cv::Mat differenceTile = this->difference(r);
+    cv::Mat greyTile       = this->greyScaleImage(r);
+    cv::Mat thresholdTile  = this->rawThreshold(r);
+    cv::accumulateWeighted(this->lastFrame(r), averageTile, alpha);
+    averageTile.convertTo(roundedTile, roundedTile.type());
+    cv::absdiff(image(r), roundedTile, differenceTile);
+    if (differenceTile.channels()==3) {
+      cv::cvtColor(differenceTile, greyTile, CV_RGB2GRAY);
+    }
+    else {
+      greyTile = differenceTile;
+    }
+    cv::threshold(greyTile, thresholdTile, threshold, 255, CV_THRESH_BINARY);
+  }
+  //
+  // erode/dilate of the refined tiles, the rest of the frame has no motion
+  //
+  this->thresholdImage.setTo(0);
+  int nonzero = 0;
+  for (int i = 0; i < tilesX*tilesY; i++) {
+    if (!refined[i]) continue;
+    cv::Rect r = cv::Rect((i % tilesX)*tileSize, (i / tilesX)*tileSize, tileSize, tileSize) & frameRect;
+    cv::Mat thresholdTile = this->thresholdImage(r);
+    if (margin==0) {
+      this->rawThreshold(r).copyTo(thresholdTile);
+    }
+    else {
+      cv::Rect outer = cv::Rect(r.x - margin, r.y - margin, r.width + 2*margin, r.height + 2*margin) & frameRect;
+      cv::Mat blobs;
+      this->rawThreshold(outer).copyTo(blobs);
+      this->erodeDilate(blobs);
+      blobs(r - outer.tl()).copyTo(thresholdTile);
+    }
+    nonzero += cv::countNonZero(thresholdTile);
+  }
+  return nonzero;
+}
+//----------------------------------------------------------------------------
+void MotionFilter::erodeDilate(cv::Mat &image)
+{
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  cv::Mat reference;
+  if (this->morphologyMethod != MorphologyMethod::vhgw) {
+    reference = this->morphologyMethod == MorphologyMethod::compare ? image.clone() : image;
+    if (this->erodeIterations>0) {
+      cv::erode(reference, reference, cv::Mat(), cv::Point(-1,-1), this->erodeIterations);
+    }
+    if (this->dilateIterations>0) {
+      cv::dilate(reference, reference, cv::Mat(), cv::Point(-1,-1), this->dilateIterations);
+    }
+  }
+  if (this->morphologyMethod != MorphologyMethod::opencv) {
+    vhgwErode(image, image, this->erodeIterations);
+    vhgwDilate(image, image, this->dilateIterations);
+  }
+  // compare keeps the OpenCV result
+  if (this->morphologyMethod == MorphologyMethod::compare) {
+    this->morphologyMismatches += cv::countNonZero(image != reference);
+    reference.copyTo(image);
+  }
+  this->morphologyTime_ms += std::chrono::duration<double, std::milli>(
+          std::chrono::steady_clock::now() - start).count();
 }
 //----------------------------------------------------------------------------
 void MotionFilter::countPixels(const cv::Mat &image)
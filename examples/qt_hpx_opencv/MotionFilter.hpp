@@ -10,6 +10,15 @@
 #include <boost/accumulators/statistics/rolling_mean.hpp>
 #include <boost/accumulators/statistics/median.hpp>
 #include <boost/accumulators/statistics/weighted_median.hpp>
+#include <boost/shared_ptr.hpp>
+//
+#include "BlobTracker.hpp"
+#include "Morphology.hpp"
+//
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
 
 class MotionFilter;
 typedef boost::shared_ptr<MotionFilter> MotionFilter_SP;
@@ -17,6 +26,83 @@ typedef boost::shared_ptr<MotionFilter> MotionFilter_SP;
 class PSNRFilter;
 class Filter;
 
+//
+// How the moving average, difference, grey conversion and threshold are
+// computed: one OpenCV call per step over the whole frame, a single fused pass
+// over tiles of rows, or both with the threshold images compared.
+//
+enum class MotionKernel : int
+{
+    opencv  = 0,
+    fused   = 1,
+    compare = 2,
+};
+
+inline bool parseMotionKernel(const std::string &name, MotionKernel &kernel) {
+  if (name == "opencv") kernel = MotionKernel::opencv;
+  else if (name == "fused") kernel = MotionKernel::fused;
+  else if (name == "compare") kernel = MotionKernel::compare;
+  else return false;
+  return true;
+}
+
+inline const char *motionKernelName(MotionKernel kernel) {
+  switch (kernel) {
+    case MotionKernel::opencv:  return "opencv";
+    case MotionKernel::fused:   return "fused";
+    case MotionKernel::compare: return "compare";
+  }
+  return "unknown";
+}
+
+//
+// Storage of the moving average: 32 bit float per channel, or 16 bit fixed
+// point with 7 fractional bits updated with integer arithmetic (half the
+// state to read and write). The fixed point model is used by the fused pass,
+// the OpenCV kernel always works on the float average.
+//
+enum class BackgroundModel : int
+{
+    float32 = 0,
+    fixed16 = 1,
+};
+
+inline bool parseBackgroundModel(const std::string &name, BackgroundModel &model) {
+  if (name == "float") model = BackgroundModel::float32;
+  else if (name == "fixed16") model = BackgroundModel::fixed16;
+  else return false;
+  return true;
+}
+
+inline const char *backgroundModelName(BackgroundModel model) {
+  switch (model) {
+    case BackgroundModel::float32: return "float";
+    case BackgroundModel::fixed16: return "fixed16";
+  }
+  return "unknown";
+}
+
+//
+// Per block state of the block skipping of the fused pass
+//
+struct MotionBlocks {
+  enum {
+    SIZE        = 16,
+    // a block is processed at least this often, so that changes slower
+    // than the skip level still reach its average
+    MAX_SKIPPED = 15,
+  };
+  MotionBlocks() : cols(0), rows(0), sadLimit(0), frame(0), skipped(0) {}
+
+  int                cols;
+  int                rows;
+  int                sadLimit;   // largest sum of absolute differences skipped
+  int                frame;
+  std::vector<uchar> motion;     // threshold pixels when last processed
+  std::vector<int>   updated;    // frame of the last average update
+  std::atomic<int>   skipped;
+};
+
 struct MotionFilterParams {
     int          threshold;
     double       average;
@@ -31,6 +117,9 @@ struct MotionFilterParams {
 //
 class MotionFilter {
 public:
+  typedef boost::accumulators::accumulator_set<int,
+    boost::accumulators::stats<boost::accumulators::tag::rolling_mean> > RollingMean;
+
    MotionFilter();
    MotionFilter(MotionFilterParams motionFilterParams);
   ~MotionFilter();
@@ -39,6 +128,17 @@ public:
   //
   void DeleteTemporaryStorage();
   void countPixels(const cv::Mat &image);
+  // the fused pass: updates average (float or fixed point short, with the
+  // channels of image), writes the threshold image, returns the number of
+  // pixels above the threshold; skipBlocks leaves out the static blocks
+  int  fusedThreshold(const cv::Mat &image, cv::Mat &average, cv::Mat &mask, bool skipBlocks = false);
+  // erode/dilate of rawThreshold into thresholdImage near the blocks with motion
+  int  blockMorphology();
+  // coarse pass at 1/pyramidScale, then the full resolution steps on the
+  // tiles with activity; writes thresholdImage, returns its non zero pixels
+  int  pyramidThreshold(const cv::Mat &image);
+  // erodeIterations 3x3 erosions, then dilateIterations dilations, in place
+  void erodeDilate(cv::Mat &image);
 
   Filter      *renderer;
 
@@ -48,6 +148,7 @@ public:
   double       motionEstimate;
   double       logMotion;
   double       rollingMean;
+  RollingMean  motionHistory;
   double       normalizedMotion;
   double       eventLevel;
 
@@ -65,6 +166,32 @@ public:
   // GUI non-tunable params
   double       triggerLevel;
   int          frameCount;
+  MotionKernel kernel;
+  BackgroundModel backgroundModel;
+  // detect motion on the grey frames, single channel background
+  bool         lumaOnly;
+  // 4 or 8: find the active tiles on a frame downscaled by this factor and
+  // only process those at full resolution, 0 for the whole frame
+  int          pyramidScale;
+  // tiles processed at full resolution / tiles seen, pyramid mode
+  int64_t      tilesRefined;
+  int64_t      tilesTotal;
+  // skip the blocks whose mean absolute difference to the last frame is at
+  // most this (fused kernel), 0 to process all of them
+  double       skipLevel;
+  int64_t      blocksSkipped;
+  int64_t      blocksTotal;
+  // threshold image pixels on which the kernels disagreed (compare only)
+  int64_t      kernelMismatches;
+  // label the threshold image and track the blobs, blobTracker.blobs holds
+  // those of the last frame
+  bool         trackBlobs;
+  BlobTracker  blobTracker;
+  int          trackedBlobs;
+  MorphologyMethod morphologyMethod;
+  // pixels on which the morphology methods disagreed (compare only)
+  int64_t      morphologyMismatches;
+  double       morphologyTime_ms;   // erode and dilate, all frames
 
   //
   // Temporary images
@@ -76,7 +203,16 @@ public:
   cv::Mat   movingAverage;
   cv::Mat   difference;
   cv::Mat   floatImage;
-  cv::Size  text_size;
+  cv::Mat   fusedAverage;
+  cv::Mat   fixedAverage;
+  // pyramid mode
+  cv::Mat   coarseAverage;
+  cv::Mat   coarseLast;
+  cv::Mat   rawThreshold;          // before erode/dilate
+  std::vector<int> tileUpdated;    // frame of the last average update per tile
+  // block skipping
+  MotionBlocks blocks;
+  cv::Mat   fusedMask;
   //
   //
   cv::Mat  lastFrame;
@@ -0,0 +1,177 @@
+#include "OverlayCompositor.hpp"
+//
+#include <opencv2/imgproc/imgproc.hpp>
+#include "opencv2/imgproc/imgproc_c.h"
+#include <opencv2/core/hal/intrin.hpp>
+//
+#include <boost/make_shared.hpp>
+//
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+//----------------------------------------------------------------------------
+OverlayCompositor &OverlayCompositor::instance()
+{
+  static OverlayCompositor *compositor = new OverlayCompositor();
+  return *compositor;
+}
+//----------------------------------------------------------------------------
+OverlayCompositor::OverlayCompositor()
+  : uses(0), stampTime(0), renders(0), blends(0), blendTime_ns(0)
+{
+}
+//----------------------------------------------------------------------------
+double OverlayCompositor::getBlendTime_us() const
+{
+  std::int64_t n = this->blends;
+  return n > 0 ? this->blendTime_ns / 1000.0 / n : 0.0;
+}
+//----------------------------------------------------------------------------
+std::tm OverlayCompositor::localTime(std::time_t time)
+{
+  std::tm local;
+#ifdef _WIN32
+  localtime_s(&local, &time);
+#else
+  localtime_r(&time, &local);
+#endif
+  return local;
+}
+//----------------------------------------------------------------------------
+void OverlayCompositor::timestamp(cv::Mat &image)
+{
+  std::string text;
+  {
+    std::lock_guard<std::mutex> lk(this->lock);
+    std::time_t now = std::time(nullptr);
+    if (now != this->stampTime || this->stampText.empty()) {
+      char date[32];
+      std::tm local = localTime(now);
+      std::strftime(date, sizeof(date), "%d/%m/%Y %H:%M:%S", &local);
+      this->stampTime = now;
+      this->stampText = date;
+    }
+    text = this->stampText;
+  }
+  cv::Scalar white(255, 255, 255, 0);
+  Bitmap_SP stamp = this->bitmap(text, white, image.type());
+  if (!stamp) {
+    cv::Size text_size = cv::getTextSize(text, CV_FONT_HERSHEY_PLAIN, 1.0, 1, NULL);
+    cv::putText(image, text, cv::Point(image.cols - text_size.width - 4, text_size.height + 4),
+      CV_FONT_HERSHEY_PLAIN, 1.0, white, 1);
+    return;
+  }
+  this->blend(image, *stamp,
+              cv::Point(image.cols - stamp->textSize.width - 4, stamp->textSize.height + 4));
+}
+//----------------------------------------------------------------------------
+void OverlayCompositor::caption(cv::Mat &image, const std::string &text, cv::Point origin,
+                                const cv::Scalar &colour)
+{
+  Bitmap_SP bitmap = this->bitmap(text, colour, image.type());
+  if (!bitmap) {
+    cv::putText(image, text, origin, CV_FONT_HERSHEY_PLAIN, 1.0, colour, 1);
+    return;
+  }
+  this->blend(image, *bitmap, origin);
+}
+//----------------------------------------------------------------------------
+// The cached bitmap of the caption, rendered on first use. Null for the
+// images the blend does not handle
+OverlayCompositor::Bitmap_SP OverlayCompositor::bitmap(const std::string &text,
+                                                       const cv::Scalar &colour, int type)
+{
+  if (CV_MAT_DEPTH(type) != CV_8U || CV_MAT_CN(type) > 4) {
+    return Bitmap_SP();
+  }
+  std::uint32_t packed = 0;
+  for (int c = 0; c < 4; c++) {
+    packed |= static_cast<std::uint32_t>(cv::saturate_cast<uchar>(colour[c])) << (8*c);
+  }
+  Key key(text, packed, type);
+  std::lock_guard<std::mutex> lk(this->lock);
+  auto it = this->bitmaps.find(key);
+  if (it == this->bitmaps.end()) {
+    // the time stamps of the past seconds go first
+    if (this->bitmaps.size() >= MAX_BITMAPS) {
+      auto oldest = std::min_element(this->bitmaps.begin(), this->bitmaps.end(),
+        [](const std::pair<const Key, Bitmap_SP> &a, const std::pair<const Key, Bitmap_SP> &b) {
+          return a.second->lastUsed < b.second->lastUsed;
+        });
+      this->bitmaps.erase(oldest);
+    }
+    it = this->bitmaps.emplace(key, this->render(text, colour, type)).first;
+  }
+  it->second->lastUsed = ++this->uses;
+  return it->second;
+}
+//----------------------------------------------------------------------------
+// cv::putText into a mask with a margin around the text box, the glyphs of
+// the Hershey fonts reach a little past it
+OverlayCompositor::Bitmap_SP OverlayCompositor::render(const std::string &text,
+                                                       const cv::Scalar &colour, int type)
+{
+  const int margin = 3;
+  int cn = CV_MAT_CN(type);
+  int baseline = 0;
+  Bitmap_SP bitmap = boost::make_shared<Bitmap>();
+  bitmap->textSize = cv::getTextSize(text, CV_FONT_HERSHEY_PLAIN, 1.0, 1, &baseline);
+  bitmap->offset   = cv::Point(-margin, -margin - bitmap->textSize.height);
+  //
+  cv::Mat mask = cv::Mat::zeros(bitmap->textSize.height + baseline + 2*margin,
+                                bitmap->textSize.width + 2*margin, CV_8UC1);
+  cv::putText(mask, text, cv::Point(margin, margin + bitmap->textSize.height),
+    CV_FONT_HERSHEY_PLAIN, 1.0, cv::Scalar(255), 1);
+  // the coverage of every channel of a pixel side by side, as in the image
+  if (cn > 1) {
+    std::vector<cv::Mat> planes(cn, mask);
+    cv::merge(planes, bitmap->alpha);
+    bitmap->alpha = bitmap->alpha.reshape(1);
+  }
+  else {
+    bitmap->alpha = mask;
+  }
+  bitmap->ink = cv::Mat(1, mask.cols, type, colour).reshape(1);
+  this->renders++;
+  return bitmap;
+}
+//----------------------------------------------------------------------------
+// image = (image*(255 - alpha) + ink*alpha)/255, rounded, over the part of
+// the bitmap inside the image
+void OverlayCompositor::blend(cv::Mat &image, const Bitmap &bitmap, cv::Point origin)
+{
+  auto start = std::chrono::steady_clock::now();
+  int cn = image.channels();
+  cv::Rect box(origin + bitmap.offset, cv::Size(bitmap.alpha.cols/cn, bitmap.alpha.rows));
+  cv::Rect clipped = box & cv::Rect(0, 0, image.cols, image.rows);
+  int n  = clipped.width*cn;
+  int x0 = (clipped.x - box.x)*cn;
+  for (int y = clipped.y; y < clipped.y + clipped.height; y++) {
+    uchar       *dst   = image.ptr<uchar>(y) + clipped.x*cn;
+    const uchar *ink   = bitmap.ink.ptr<uchar>(0) + x0;
+    const uchar *alpha = bitmap.alpha.ptr<uchar>(y - box.y) + x0;
+    int x = 0;
+#if CV_SIMD128
+    cv::v_uint16x8 v255 = cv::v_setall_u16(255), v128 = cv::v_setall_u16(128);
+    for (; x <= n - 16; x += 16) {
+      cv::v_uint16x8 d0, d1, i0, i1, a0, a1;
+      cv::v_expand(cv::v_load(dst + x), d0, d1);
+      cv::v_expand(cv::v_load(ink + x), i0, i1);
+      cv::v_expand(cv::v_load(alpha + x), a0, a1);
+      cv::v_uint16x8 s0 = d0*(v255 - a0) + i0*a0 + v128;
+      cv::v_uint16x8 s1 = d1*(v255 - a1) + i1*a1 + v128;
+      s0 = (s0 + (s0 >> 8)) >> 8;
+      s1 = (s1 + (s1 >> 8)) >> 8;
+      cv::v_store(dst + x, cv::v_pack(s0, s1));
+    }
+#endif
+    for (; x < n; x++) {
+      int s = dst[x]*(255 - alpha[x]) + ink[x]*alpha[x] + 128;
+      dst[x] = static_cast<uchar>((s + (s >> 8)) >> 8);
+    }
+  }
+  this->blends++;
+  this->blendTime_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now() - start).count();
+}
@@ -0,0 +1,81 @@
+#ifndef OVERLAY_COMPOSITOR_H
+#define OVERLAY_COMPOSITOR_H
+
+#include <opencv2/core/core.hpp>
+//
+#include <boost/shared_ptr.hpp>
+//
+#include <atomic>
+#include <cstdint>
+#include <ctime>
+#include <map>
+#include <mutex>
+#include <string>
+#include <tuple>
+
+//
+// Text drawn over the frames: the date and time stamp of the capture, the
+// recorder and the filters, and the track numbers of the blobs.
+//
+// Every distinct caption (text, colour and image type) is rendered once with
+// cv::putText into a small bitmap with an alpha mask, kept in a cache shared
+// by every thread of the process, and alpha blended into the frames that
+// show it. The time stamp is formatted once per second, so a frame costs a
+// cache lookup and a blend over the few pixels of the text instead of the
+// formatting, measuring and rasterizing of the glyphs.
+//
+class OverlayCompositor {
+public:
+  // process-wide cache, never destroyed
+  static OverlayCompositor &instance();
+
+  // date and time at the top right of the image, in white
+  void timestamp(cv::Mat &image);
+  // text with the baseline of its first character at origin, as cv::putText
+  // with CV_FONT_HERSHEY_PLAIN, scale 1 and thickness 1
+  void caption(cv::Mat &image, const std::string &text, cv::Point origin,
+               const cv::Scalar &colour);
+
+  // captions rasterized and blended since the start
+  std::int64_t getRenders() const { return this->renders; }
+  std::int64_t getBlends() const { return this->blends; }
+  // time of a blend in microseconds, averaged since the start
+  double getBlendTime_us() const;
+
+  // std::localtime without its shared static buffer, the time stamps and
+  // the names of the event clips are formatted from several threads
+  static std::tm localTime(std::time_t time);
+
+private:
+  OverlayCompositor();
+
+  // the text, its colour packed as BGRA and the type of the images it is
+  // blended into
+  typedef std::tuple<std::string, std::uint32_t, int> Key;
+  struct Bitmap {
+    cv::Mat   ink;       // one row of the colour, cols*channels values
+    cv::Mat   alpha;     // coverage of every value of the box, 0 or 255
+    cv::Point offset;    // top left of the box from the text origin
+    cv::Size  textSize;  // as cv::getTextSize
+    std::uint64_t lastUsed;
+  };
+  typedef boost::shared_ptr<Bitmap> Bitmap_SP;
+
+  static const std::size_t MAX_BITMAPS = 64;
+
+  Bitmap_SP bitmap(const std::string &text, const cv::Scalar &colour, int type);
+  Bitmap_SP render(const std::string &text, const cv::Scalar &colour, int type);
+  void      blend(cv::Mat &image, const Bitmap &bitmap, cv::Point origin);
+
+  std::mutex                 lock;
+  std::map<Key, Bitmap_SP>   bitmaps;
+  std::uint64_t              uses;
+  std::time_t                stampTime;
+  std::string                stampText;
+  //
+  std::atomic<std::int64_t>  renders;
+  std::atomic<std::int64_t>  blends;
+  std::atomic<std::int64_t>  blendTime_ns;
+};
+
+#endif
@@ -0,0 +1,36 @@
+#ifndef PIPELINE_PARAMS_H
+#define PIPELINE_PARAMS_H
+
+#include "ConcurrentRingBuffer.hpp"
+#include "EventRecorder.hpp"
+#include "MotionFilter.hpp"
+
+//
+// Parameters of the capture->processing pipeline, set from the command line
+//
+struct PipelineParams {
+    BufferPolicy bufferPolicy;
+    int          bufferCapacity;
+    // FramePipeline instead of the capture and processing loops
+    bool         dataflowPipeline;
+    int          framesInFlight;
+    // frames detected at the same time by face recognition
+    int          faceRecogTasks;
+    // implementation of the motion detection steps
+    MotionKernel motionKernel;
+    BackgroundModel backgroundModel;
+    // motion detection on grey frames only
+    bool         motionLuma;
+    // downscale factor of the coarse motion pass, 0 for none
+    int          motionPyramid;
+    // mean absolute difference below which static blocks are skipped, 0 for none
+    double       motionSkipLevel;
+    // connected components of the motion mask, tracked across frames
+    bool         motionBlobs;
+    // implementation of the erode/dilate iterations
+    MorphologyMethod morphology;
+    // clips of the motion events
+    EventRecorderParams eventRecording;
+};
+
+#endif
@@ -0,0 +1,309 @@
+#include "SyntheticCapture.hpp"
+//
+#include <opencv2/imgcodecs/imgcodecs.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+#include "opencv2/videoio/videoio_c.h"
+//
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+namespace {
+  const std::string SYNTHETIC_SCHEME = "synthetic://";
+  const int NUM_NOISE_FRAMES = 4;
+}
+
+//----------------------------------------------------------------------------
+SyntheticCapture::SyntheticCapture()
+  : cv::VideoCapture(), opened(false), size(640, 480), fps(0.0), numShapes(3), motion(0.05),
+    numFaces(0), noise(0.0), seed(1), failAfter(0), shapeSize(0), frameNumber(0)
+{
+}
+//----------------------------------------------------------------------------
+bool SyntheticCapture::isSyntheticURL(const std::string &URL)
+{
+  return URL.compare(0, SYNTHETIC_SCHEME.size(), SYNTHETIC_SCHEME) == 0;
+}
+//----------------------------------------------------------------------------
+bool SyntheticCapture::open(const cv::String &URL)
+{
+  this->release();
+  std::string url(URL.c_str());
+  if (!isSyntheticURL(url)) {
+    return false;
+  }
+
+  // key=value pairs after the scheme, separated by '&', optionally after a '?'
+  std::string query = url.substr(SYNTHETIC_SCHEME.size());
+  if (!query.empty() && query[0] == '?') {
+    query = query.substr(1);
+  }
+  std::istringstream pairs(query);
+  std::string pair;
+  while (std::getline(pairs, pair, '&')) {
+    std::size_t eq = pair.find('=');
+    if (pair.empty() || eq == std::string::npos) {
+      continue;
+    }
+    std::string key = pair.substr(0, eq);
+    std::string value = pair.substr(eq + 1);
+    if (key == "width")       this->size.width = std::atoi(value.c_str());
+    else if (key == "height") this->size.height = std::atoi(value.c_str());
+    else if (key == "fps")    this->fps = std::atof(value.c_str());
+    else if (key == "shapes") this->numShapes = std::atoi(value.c_str());
+    else if (key == "motion") this->motion = std::atof(value.c_str());
+    else if (key == "faces")  this->numFaces = std::atoi(value.c_str());
+    else if (key == "face")   this->faceFile = value;
+    else if (key == "noise")  this->noise = std::atof(value.c_str());
+    else if (key == "seed")   this->seed = static_cast<unsigned int>(std::atoi(value.c_str()));
+    else if (key == "fail")   this->failAfter = std::atoll(value.c_str());
+    else {
+      std::cout << "SyntheticCapture: ignoring unknown parameter " << key << std::endl;
+    }
+  }
+  if (this->size.width <= 0 || this->size.height <= 0) {
+    std::cout << "SyntheticCapture: invalid frame size" << std::endl;
+    return false;
+  }
+  this->motion = std::min(std::max(this->motion, 0.0), 1.0);
+
+  this->opened = true;
+  this->createScene();
+  return true;
+}
+//----------------------------------------------------------------------------
+bool SyntheticCapture::open(int /*index*/)
+{
+  return false;
+}
+//----------------------------------------------------------------------------
+bool SyntheticCapture::isOpened() const
+{
+  return this->opened;
+}
+//----------------------------------------------------------------------------
+void SyntheticCapture::release()
+{
+  this->opened = false;
+  this->background.release();
+  this->noiseFrames.clear();
+  this->shapes.clear();
+  this->faces.clear();
+}
+//----------------------------------------------------------------------------
+// Waits for the time of the next frame like a camera does
+bool SyntheticCapture::grab()
+{
+  if (!this->opened) {
+    return false;
+  }
+  if (this->failAfter > 0 && this->frameNumber >= this->failAfter) {
+    CV_Error(cv::Error::StsError, "synthetic camera failure");
+  }
+  if (this->fps > 0) {
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    std::chrono::steady_clock::duration period =
+            std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                    std::chrono::duration<double>(1.0 / this->fps));
+    if (this->nextFrameTime > now) {
+      std::this_thread::sleep_until(this->nextFrameTime);
+    }
+    else if (now - this->nextFrameTime > period) {
+      // the reader fell behind, frames in between were missed
+      this->nextFrameTime = now;
+    }
+    this->nextFrameTime += period;
+  }
+  this->frameNumber++;
+  return true;
+}
+//----------------------------------------------------------------------------
+bool SyntheticCapture::retrieve(cv::OutputArray image, int /*flag*/)
+{
+  if (!this->opened) {
+    image.release();
+    return false;
+  }
+  // render straight into the caller's buffer, which may come from a pool
+  image.create(this->size, CV_8UC3);
+  cv::Mat frame = image.getMat();
+  this->render(frame);
+  return true;
+}
+//----------------------------------------------------------------------------
+bool SyntheticCapture::read(cv::OutputArray image)
+{
+  if (this->grab()) {
+    return this->retrieve(image);
+  }
+  image.release();
+  return false;
+}
+//----------------------------------------------------------------------------
+cv::VideoCapture &SyntheticCapture::operator>>(cv::Mat &image)
+{
+  this->read(image);
+  return *this;
+}
+//----------------------------------------------------------------------------
+bool SyntheticCapture::set(int propId, double value)
+{
+  switch (propId) {
+    case CV_CAP_PROP_FRAME_WIDTH:
+      this->size.width = static_cast<int>(value);
+      break;
+    case CV_CAP_PROP_FRAME_HEIGHT:
+      this->size.height = static_cast<int>(value);
+      break;
+    default:
+      // the rate is fixed by the URL, like a camera with a fixed frame rate
+      return false;
+  }
+  if (this->opened) {
+    this->createScene();
+  }
+  return true;
+}
+//----------------------------------------------------------------------------
+double SyntheticCapture::get(int propId) const
+{
+  switch (propId) {
+    case CV_CAP_PROP_FRAME_WIDTH:  return this->size.width;
+    case CV_CAP_PROP_FRAME_HEIGHT: return this->size.height;
+    case CV_CAP_PROP_FPS:          return this->fps;
+    case CV_CAP_PROP_POS_FRAMES:   return static_cast<double>(this->frameNumber);
+    default:                       return 0;
+  }
+}
+//----------------------------------------------------------------------------
+// Background, noise and the initial positions of the shapes and faces for
+// the current frame size. The shapes are sized so that together they cover
+// the requested fraction of the image.
+void SyntheticCapture::createScene()
+{
+  this->random.seed(this->seed);
+  const cv::Size &sz = this->size;
+
+  // smooth gradient with a coarse grid, gives the motion filter some texture
+  this->background.create(sz, CV_8UC3);
+  for (int y = 0; y < sz.height; ++y) {
+    cv::Vec3b *row = this->background.ptr<cv::Vec3b>(y);
+    for (int x = 0; x < sz.width; ++x) {
+      bool grid = (x % 64 == 0) || (y % 64 == 0);
+      row[x] = cv::Vec3b(static_cast<uchar>(64 + (128 * x) / sz.width),
+                         static_cast<uchar>(64 + (128 * y) / sz.height),
+                         static_cast<uchar>(grid ? 200 : 96));
+    }
+  }
+
+  // the noise of every frame is one of a few precomputed patterns, gaussian
+  // noise at full resolution is too slow to generate per frame
+  this->noiseFrames.clear();
+  if (this->noise > 0) {
+    cv::RNG rng(this->seed);
+    for (int i = 0; i < NUM_NOISE_FRAMES; ++i) {
+      cv::Mat n(sz, CV_16SC3);
+      rng.fill(n, cv::RNG::NORMAL, cv::Scalar::all(0), cv::Scalar::all(this->noise));
+      this->noiseFrames.push_back(n);
+    }
+  }
+
+  std::uniform_real_distribution<double> unit(0.0, 1.0);
+  auto randomShape = [&](int extent, double speed) {
+    Shape shape;
+    shape.position = cv::Point2d(unit(this->random) * std::max(sz.width - extent, 1),
+                                 unit(this->random) * std::max(sz.height - extent, 1));
+    double angle = unit(this->random) * 2 * CV_PI;
+    shape.velocity = cv::Point2d(speed * std::cos(angle), speed * std::sin(angle));
+    shape.color = cv::Scalar(255 * unit(this->random), 255 * unit(this->random), 255 * unit(this->random));
+    shape.circle = unit(this->random) < 0.5;
+    return shape;
+  };
+
+  this->shapes.clear();
+  this->shapeSize = 0;
+  if (this->numShapes > 0 && this->motion > 0) {
+    double area = this->motion * sz.area() / this->numShapes;
+    this->shapeSize = std::max(1, static_cast<int>(std::sqrt(area)));
+    for (int i = 0; i < this->numShapes; ++i) {
+      this->shapes.push_back(randomShape(this->shapeSize, 2.0 + 6.0 * unit(this->random)));
+    }
+  }
+
+  this->faces.clear();
+  this->face.release();
+  if (this->numFaces > 0) {
+    int faceSize = std::max(32, std::min(sz.width, sz.height) / 4);
+    cv::Mat crop;
+    if (!this->faceFile.empty()) {
+      crop = cv::imread(this->faceFile, cv::IMREAD_COLOR);
+      if (crop.empty()) {
+        std::cout << "SyntheticCapture: could not read " << this->faceFile << std::endl;
+      }
+    }
+    if (crop.empty()) {
+      // a drawn face, enough for the eyes and the outline to show up
+      crop = cv::Mat(faceSize, faceSize, CV_8UC3, cv::Scalar(60, 60, 60));
+      cv::Point c(faceSize / 2, faceSize / 2);
+      cv::ellipse(crop, c, cv::Size(faceSize * 3 / 8, faceSize * 15 / 32), 0, 0, 360,
+                  cv::Scalar(150, 180, 220), -1);
+      cv::circle(crop, cv::Point(faceSize * 3 / 8, faceSize * 13 / 32), faceSize / 16,
+                 cv::Scalar(40, 30, 30), -1);
+      cv::circle(crop, cv::Point(faceSize * 5 / 8, faceSize * 13 / 32), faceSize / 16,
+                 cv::Scalar(40, 30, 30), -1);
+      cv::ellipse(crop, cv::Point(c.x, faceSize * 11 / 16), cv::Size(faceSize / 6, faceSize / 16),
+                  0, 0, 180, cv::Scalar(60, 60, 140), 2);
+    }
+    cv::resize(crop, this->face, cv::Size(faceSize, faceSize));
+    for (int i = 0; i < this->numFaces; ++i) {
+      this->faces.push_back(randomShape(faceSize, 1.0));
+    }
+  }
+}
+//----------------------------------------------------------------------------
+void SyntheticCapture::render(cv::Mat &image)
+{
+  this->background.copyTo(image);
+
+  // moves a shape of the given extent and bounces it off the borders
+  auto advance = [&](Shape &shape, int extent) {
+    shape.position += shape.velocity;
+    if (shape.position.x < 0 || shape.position.x > image.cols - extent) {
+      shape.velocity.x = -shape.velocity.x;
+      shape.position.x = std::min(std::max(shape.position.x, 0.0), std::max(image.cols - extent, 0) * 1.0);
+    }
+    if (shape.position.y < 0 || shape.position.y > image.rows - extent) {
+      shape.velocity.y = -shape.velocity.y;
+      shape.position.y = std::min(std::max(shape.position.y, 0.0), std::max(image.rows - extent, 0) * 1.0);
+    }
+  };
+
+  for (Shape &shape : this->shapes) {
+    cv::Point p(cvRound(shape.position.x), cvRound(shape.position.y));
+    if (shape.circle) {
+      int radius = this->shapeSize / 2;
+      cv::circle(image, p + cv::Point(radius, radius), radius, shape.color, -1);
+    }
+    else {
+      cv::rectangle(image, cv::Rect(p, cv::Size(this->shapeSize, this->shapeSize)), shape.color, -1);
+    }
+    advance(shape, this->shapeSize);
+  }
+
+  for (Shape &f : this->faces) {
+    cv::Rect target(cv::Point(cvRound(f.position.x), cvRound(f.position.y)), this->face.size());
+    cv::Rect visible = target & cv::Rect(0, 0, image.cols, image.rows);
+    if (visible.area() > 0) {
+      this->face(visible - target.tl()).copyTo(image(visible));
+    }
+    advance(f, this->face.cols);
+  }
+
+  if (!this->noiseFrames.empty()) {
+    const cv::Mat &n = this->noiseFrames[this->frameNumber % this->noiseFrames.size()];
+    cv::add(image, n, image, cv::noArray(), CV_8UC3);
+  }
+}
@@ -0,0 +1,83 @@
+#ifndef SYNTHETIC_CAPTURE_H
+#define SYNTHETIC_CAPTURE_H
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/videoio/videoio.hpp>
+//
+#include <chrono>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+//
+// Frame generator which stands in for a camera, so that the capture and
+// processing pipeline runs without hardware. It is opened with a URL
+//
+//   synthetic://?width=640&height=480&fps=30&shapes=3&motion=0.05&faces=1&noise=8
+//
+// every parameter is optional:
+//   width, height : frame size, also changed with CV_CAP_PROP_FRAME_WIDTH/HEIGHT
+//   fps           : frames per second, 0 (default) delivers a frame on every read
+//   shapes        : number of moving shapes
+//   motion        : fraction of the image covered by the moving shapes
+//   faces         : number of faces moving slowly through the image
+//   face          : image file with a face crop, a drawn face when not given
+//   noise         : standard deviation of the gaussian noise added to every frame
+//   seed          : seed of the random shapes and noise
+//   fail          : throw a cv::Exception from the read after that many frames,
+//                   to check how the pipeline handles a failing camera
+//
+class SyntheticCapture : public cv::VideoCapture {
+public:
+  SyntheticCapture();
+
+  static bool isSyntheticURL(const std::string &URL);
+
+  bool open(const cv::String &URL) override;
+  bool open(int index) override;
+  bool isOpened() const override;
+  void release() override;
+
+  bool grab() override;
+  bool retrieve(cv::OutputArray image, int flag = 0) override;
+  bool read(cv::OutputArray image) override;
+  cv::VideoCapture &operator>>(cv::Mat &image) override;
+
+  bool set(int propId, double value) override;
+  double get(int propId) const override;
+
+private:
+  struct Shape {
+    cv::Point2d position;
+    cv::Point2d velocity;       // pixels per frame
+    cv::Scalar  color;
+    bool        circle;
+  };
+
+  void createScene();
+  void render(cv::Mat &image);
+
+  bool             opened;
+  cv::Size         size;
+  double           fps;
+  int              numShapes;
+  double           motion;
+  int              numFaces;
+  std::string      faceFile;
+  double           noise;
+  unsigned int     seed;
+  std::int64_t     failAfter;       // frames, 0 never fails
+  //
+  std::mt19937     random;
+  cv::Mat          background;
+  cv::Mat          face;
+  std::vector<cv::Mat> noiseFrames;
+  std::vector<Shape> shapes;
+  std::vector<Shape> faces;
+  int              shapeSize;
+  std::int64_t     frameNumber;
+  std::chrono::steady_clock::time_point nextFrameTime;
+};
+
+#endif
@@ -7,19 +7,29 @@
 #include <opencv2/highgui/highgui.hpp>
 //
 #include <QMutex>
+#include <QTime>
 #include <QWaitCondition>
 //
 #include <boost/shared_ptr.hpp>
 #include <boost/lockfree/spsc_queue.hpp>
 //
+#include <atomic>
+#include <functional>
+//
 #include <hpx/parallel/execution.hpp>
 #include <hpx/parallel/executors/pool_executor.hpp>
+#include <hpx/lcos/future.hpp>
+#include <hpx/lcos/local/condition_variable.hpp>
+#include <hpx/lcos/local/mutex.hpp>
 //
-#include "ConcurrentCircularBuffer.hpp"
+#include "ConcurrentRingBuffer.hpp"
+#include "EventRecorder.hpp"
+#include "Frame.hpp"
+#include <boost/circular_buffer.hpp>
 #define IMAGE_QUEUE_LEN 1024
 
 typedef boost::circular_buffer< int > IntCircBuff;
-typedef boost::shared_ptr< ConcurrentCircularBuffer<cv::Mat> > ImageBuffer;
+typedef boost::shared_ptr< ConcurrentRingBuffer<Frame> > ImageBuffer;
 typedef boost::shared_ptr< boost::lockfree::spsc_queue<cv::Mat, boost::lockfree::capacity<IMAGE_QUEUE_LEN>> > ImageQueue;
 
 class CaptureThread;
@@ -30,11 +40,31 @@ public:
    CaptureThread(ImageBuffer imageBuffer, const cv::Size &size, int rotation, int device,
                  const std::string &URL,
                  hpx::threads::executors::pool_executor exec,
+                 hpx::threads::executors::pool_executor ioExec,
+                 hpx::threads::executors::pool_executor decodeExec,
                  int requestedFps);
   ~CaptureThread() ;
 
   void run();
   //
+  // The stages of run(), also driven frame by frame by FramePipeline
+  //
+  Frame::clock::time_point nextFrameDeadline();
+  bool grabFrame(Frame &frame);
+  void prepareFrame(Frame &frame);
+  void recordFrame(Frame &frame);
+  //
+  // When set, startCapture() calls the driver instead of launching run().
+  // The driver stops grabbing once isAborting() and calls runFinished()
+  // when its last frame is done, which lets stopCapture() return.
+  //
+  void setExternalDriver(std::function<void()> driver) { this->externalDriver = std::move(driver); }
+  bool isAborting() { return this->abort; }
+  void runFinished();
+  // after the last frame or a failed grab: the driver stops grabbing and
+  // stopCapture() has nothing to wait for
+  void endCapture(const std::string &reason);
+  //
   bool connectCamera(int index, const std::string &URL);
   bool startCapture();
   bool stopCapture();
@@ -44,6 +74,7 @@ public:
   void setRequestedFps(int value);
   double getActualFps() { return actualFps; }
   int getSleepTime() {return sleepTime_ms; }
+  double getFrameJitter_ms() { return this->frameJitter_ms; }
   int getCaptureTime() { return captureTime_ms; }
   bool isCapturing() { return captureActive; }
   bool isRequestedSizeCorrect() { return requestedSizeCorrect; }
@@ -62,8 +93,14 @@ public:
   // General
   //
   void setWriteMotionAVIDir(const char *dir);
+  void queueAVIFrame(const cv::Mat &image);
   void saveAVI(const cv::Mat &image);
+  int  getDroppedAVIFrames() { return this->droppedAVIFrames; }
   void closeAVI();
+  //
+  // Motion events, every frame is handed to the recorder
+  //
+  void setEventRecorder(EventRecorder_SP recorder) { this->eventRecorder = recorder; }
 
   void setRotation(int value);
   //
@@ -77,43 +114,59 @@ private:
   bool tryResolutionUpdate(cv::Size requestedResolution);
 
   void setAbort(bool a) { this->abort = a; }
+  bool waitUntilActive();
   void updateActualFps(int time_ms);
   void updateCaptureTime(int time_ms);
+  void updateFrameJitter(int interval_us);
 
   //
   QMutex           stopLock;
   QWaitCondition   stopWait;
+  bool             running;   // from startCapture() to runFinished(), under stopLock
   hpx::threads::executors::pool_executor executor;
+  hpx::threads::executors::pool_executor ioExecutor;       // AVI writes
+  hpx::threads::executors::pool_executor decodeExecutor;
   //
-  bool             abort; 
+  std::atomic<bool> abort;
   ImageBuffer      imageBuffer;
-  bool             captureActive;
+  std::atomic<bool> captureActive;
   bool             deInterlace;
   cv::Size         imageSize;
   bool             requestedSizeCorrect;
   cv::Size         rotatedSize;
-  cv::VideoCapture capture;
+  boost::shared_ptr<cv::VideoCapture> capture;   // SyntheticCapture, MjpegCapture or an OpenCV capture
   double           actualFps;
-  int              requestedFps;
+  std::atomic<int> requestedFps;     // set by the GUI, read by the capture
   int              sleepTime_ms;
   int              captureTime_ms;
   IntCircBuff      frameTimes;
   IntCircBuff      captureTimes;
+  QTime            actualFpsTime;
+  IntCircBuff      frameIntervals;      // between captured frames, in us, capture side only
+  std::atomic<bool>   resetIntervals;   // set by setRequestedFps, the capture clears them
+  std::atomic<double> frameJitter_ms;   // of frameIntervals, published for the GUI
+  Frame::clock::time_point frameDeadline;
+  std::atomic<bool> resetDeadline;    // set by setRequestedFps, the capture restarts the schedule
+  Frame::clock::time_point lastCaptureTime;
+  hpx::lcos::local::mutex  activeLock;
+  hpx::lcos::local::condition_variable activeChanged;
+  QTime            captureWaitTime;
+  std::function<void()> externalDriver;
   int              deviceIndex;
   int              rotation;
   int              FrameCounter;
-  ImageBuffer      aviBuffer;
   //
   cv::VideoWriter  MotionAVI_Writer;
-  bool             MotionAVI_Writing;
+  std::atomic<bool> MotionAVI_Writing;
+  std::atomic<bool> MotionAVI_Open;
+  std::atomic<int> pendingAVIFrames;
+  std::atomic<int> droppedAVIFrames;
+  hpx::future<void> aviWriting;
+  EventRecorder_SP eventRecorder;
   std::string      AVI_Directory;
   std::string      MotionAVI_Name;
   std::string      CaptureStatus;
   std::string      CameraURL;
-  //
-  cv::Size         text_size;
-  cv::Mat          currentFrame;
-  cv::Mat          rotatedImage;
 };
 
 #endif
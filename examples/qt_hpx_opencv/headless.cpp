@@ -0,0 +1,563 @@
+//
+// Runs the capture -> processing pipeline of MartyCam without a window:
+// CaptureThread -> buffer (or FramePipeline) -> ProcessingThread -> a renderer
+// which drops the frames, once per camera. Every frame carries its capture
+// time and sequence number, at the end the throughput and the latency
+// percentiles are printed on a single line per camera. With --selftest the
+// hand-over of the frames is checked as well and the exit code is 1 if a
+// frame arrived shared with another owner or out of order.
+//
+#include <hpx/hpx_init.hpp>
+#include <hpx/include/async.hpp>
+#include <hpx/include/iostreams.hpp>
+#include <hpx/include/resource_partitioner.hpp>
+#include <hpx/include/threads.hpp>
+//
+#include "CameraChain.hpp"
+#include "FramePool.hpp"
+#include "OverlayCompositor.hpp"
+#include "PipelineParams.hpp"
+#include "filter.hpp"
+#include "blocking_detector.hpp"
+#include "priority_lanes.hpp"
+//
+#include <boost/make_shared.hpp>
+//
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+#include <numeric>
+#include <string>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////
+/// Function Declarations
+
+double percentile(std::vector<double> values, double p);
+double standard_deviation(const std::vector<double>& values);
+bool selftest_buffer(const priority_lanes& lanes, BufferPolicy policy);
+bool selftest_chains(const std::vector<CameraChain_SP>& chains);
+bool selftest_capture_error(const priority_lanes& lanes, bool dataflow);
+
+///////////////////////////////////////////////////////////////////////////
+/// Function Definitions
+
+// set from the command line in main(), used by hpx_main
+struct HeadlessParams {
+    std::vector<std::string> sources;
+    int                      cameras;
+    int                      frames;
+    double                   duration;
+    bool                     selftest;
+    CameraChainParams        chain;
+};
+static HeadlessParams params;
+
+// stands in for the RenderWidget
+class NullRenderer : public Filter {
+public:
+    void process(const cv::Mat&) override {}
+};
+
+double percentile(std::vector<double> values, double p)
+{
+    if (values.empty())
+        return 0.0;
+    std::sort(values.begin(), values.end());
+    std::size_t index = static_cast<std::size_t>(p * values.size());
+    return values[(std::min)(index, values.size() - 1)];
+}
+
+double standard_deviation(const std::vector<double>& values)
+{
+    if (values.size() < 2)
+        return 0.0;
+    double mean = std::accumulate(values.begin(), values.end(), 0.0) / values.size();
+    double variance = 0.0;
+    for (double v : values)
+        variance += (v - mean) * (v - mean);
+    return std::sqrt(variance / values.size());
+}
+
+///////////////////////////////////////////////////////////////////////////
+// single line summary of one camera, or of all of them (camera=all)
+void print_summary(const std::string& camera, const CameraChainParams& cp,
+    const std::vector<CameraChain_SP>& chains)
+{
+    const PipelineParams& pp = cp.pipeline;
+    std::vector<double> glassToRender, captureStage, queueWait, processing,
+        captureInterval;
+    std::uint64_t lost = 0;
+    double fps = 0.0;
+    std::int64_t kernelMismatches = 0, tilesRefined = 0, tilesTotal = 0,
+        blocksSkipped = 0, blocksTotal = 0, blobFrames = 0, blobsTotal = 0;
+    double blobTime = 0.0, morphologyTime = 0.0;
+    std::int64_t motionFrames = 0, morphologyMismatches = 0;
+    std::int64_t events = 0, recordedFrames = 0, recordDropped = 0;
+    for (const CameraChain_SP& chain : chains)
+    {
+        LatencySamples& samples = chain->getSamples();
+        std::lock_guard<LatencySamples::mutex_type> lk(samples.mtx);
+        auto append = [](std::vector<double>& to, const std::vector<double>& from) {
+            to.insert(to.end(), from.begin(), from.end());
+        };
+        append(glassToRender, samples.glassToRender);
+        append(captureStage, samples.captureStage);
+        append(queueWait, samples.queueWait);
+        append(processing, samples.processing);
+        append(captureInterval, samples.captureInterval);
+        lost += samples.lost;
+        double seconds =
+            std::chrono::duration<double>(samples.last - samples.first).count();
+        std::size_t n = samples.glassToRender.size();
+        fps += n > 1 && seconds > 0 ? (n - 1) / seconds : 0.0;
+        //
+        MotionFilter_SP motion = chain->getProcessingThread()->motionFilter;
+        kernelMismatches += motion->kernelMismatches;
+        tilesRefined += motion->tilesRefined;
+        tilesTotal += motion->tilesTotal;
+        blocksSkipped += motion->blocksSkipped;
+        blocksTotal += motion->blocksTotal;
+        blobFrames += motion->blobTracker.frames;
+        blobsTotal += motion->blobTracker.blobsTotal;
+        blobTime += motion->blobTracker.time_ms;
+        motionFrames += motion->frameCount;
+        morphologyTime += motion->morphologyTime_ms;
+        morphologyMismatches += motion->morphologyMismatches;
+        if (EventRecorder_SP recorder = chain->getEventRecorder())
+        {
+            events += recorder->getEvents();
+            recordedFrames += recorder->getRecordedFrames();
+            recordDropped += recorder->getDroppedFrames();
+        }
+    }
+
+    hpx::cout << "[headless] camera=" << camera
+              << " source=" << cp.source
+              << " size=" << cp.size.width << "x" << cp.size.height
+              << " pipeline=" << (pp.dataflowPipeline ? "dataflow" : "loops")
+              << " processing="
+              << (cp.processing == ProcessingType::faceRecognition ? "face" : "motion")
+              << " buffer=" << bufferPolicyName(pp.bufferPolicy)
+              << " motion_kernel=" << motionKernelName(pp.motionKernel)
+              << " background=" << backgroundModelName(pp.backgroundModel)
+              << " luma=" << pp.motionLuma
+              << " pyramid=" << pp.motionPyramid
+              << " skip_level=" << pp.motionSkipLevel
+              << " blobs=" << pp.motionBlobs
+              << " morphology=" << morphologyMethodName(pp.morphology)
+              << " erode=" << cp.motionFilter.erodeIterations
+              << " dilate=" << cp.motionFilter.dilateIterations
+              << " frames=" << glassToRender.size() << " lost=" << lost
+              << " fps=" << fps
+              << " glass_to_render_p50_ms=" << percentile(glassToRender, 0.5)
+              << " glass_to_render_p90_ms=" << percentile(glassToRender, 0.9)
+              << " glass_to_render_p99_ms=" << percentile(glassToRender, 0.99)
+              << " glass_to_render_max_ms=" << percentile(glassToRender, 1.0)
+              << " capture_p50_ms=" << percentile(captureStage, 0.5)
+              << " capture_p99_ms=" << percentile(captureStage, 0.99)
+              << " queue_p50_ms=" << percentile(queueWait, 0.5)
+              << " queue_p99_ms=" << percentile(queueWait, 0.99)
+              << " processing_p50_ms=" << percentile(processing, 0.5)
+              << " processing_p99_ms=" << percentile(processing, 0.99)
+              << " interval_p50_ms=" << percentile(captureInterval, 0.5)
+              << " interval_jitter_ms=" << standard_deviation(captureInterval)
+              << " interval_max_ms=" << percentile(captureInterval, 1.0)
+              << " frame_allocs_per_s=" << FramePool::instance().getAllocationsPerSecond()
+              << " kernel_mismatch_px=" << kernelMismatches
+              << " refined_tiles="
+              << (tilesTotal > 0 ? static_cast<double>(tilesRefined) / tilesTotal : 0.0)
+              << " skipped_blocks="
+              << (blocksTotal > 0 ? static_cast<double>(blocksSkipped) / blocksTotal : 0.0)
+              << " blobs_per_frame="
+              << (blobFrames > 0 ? static_cast<double>(blobsTotal) / blobFrames : 0.0)
+              << " blob_ms=" << (blobFrames > 0 ? blobTime / blobFrames : 0.0)
+              << " morphology_ms="
+              << (motionFrames > 0 ? morphologyTime / motionFrames : 0.0)
+              << " morphology_mismatch_px=" << morphologyMismatches
+              << " events=" << events
+              << " recorded_frames=" << recordedFrames
+              << " record_dropped=" << recordDropped
+              << " overlay_renders=" << OverlayCompositor::instance().getRenders()
+              << " overlay_us=" << OverlayCompositor::instance().getBlendTime_us()
+              << "\n" << hpx::flush;
+}
+
+///////////////////////////////////////////////////////////////////////////
+// Ownership and ordering of the frames handed from capture to processing
+
+// Numbered frames with pooled buffers go from a producer task through a
+// small ring buffer with the given policy to this task, which writes to
+// them in place as the filters do. Every frame must arrive as the only
+// owner of its buffer, with the content it was sent with and after the
+// frames sent before it; with block-producer none may be lost.
+bool selftest_buffer(const priority_lanes& lanes, BufferPolicy policy)
+{
+    const std::uint64_t frames = 2000;
+    ConcurrentRingBuffer<Frame> buffer(4, policy);
+    hpx::future<void> producer = hpx::async(lanes.normal, [&buffer, frames]() {
+        for (std::uint64_t i = 1; i <= frames; ++i)
+        {
+            cv::Mat image = FramePool::instance().create(cv::Size(64, 16), CV_8UC1);
+            image.setTo(cv::Scalar(static_cast<double>(i & 0xff)));
+            buffer.send(Frame(std::move(image), i, Frame::clock::now()));
+        }
+        // the end marker, drop-newest refuses it while the buffer is full
+        while (!buffer.send(Frame()))
+            hpx::this_thread::yield();
+    });
+
+    std::uint64_t received = 0, shared = 0, outOfOrder = 0, overwritten = 0;
+    std::uint64_t last = 0;
+    for (;;)
+    {
+        Frame frame = buffer.receive();
+        if (frame.image.empty())
+            break;
+        ++received;
+        if (frame.image.u == nullptr || frame.image.u->refcount != 1)
+            ++shared;
+        if (frame.sequence <= last)
+            ++outOfOrder;
+        last = frame.sequence;
+        if (cv::countNonZero(frame.image != static_cast<int>(frame.sequence & 0xff)) != 0)
+            ++overwritten;
+        frame.image.setTo(cv::Scalar(0));
+    }
+    producer.get();
+
+    bool complete = policy != BufferPolicy::blockProducer || received == frames;
+    bool passed = received > 0 && complete && shared == 0 && outOfOrder == 0 &&
+                  overwritten == 0;
+    hpx::cout << "[selftest] buffer policy=" << bufferPolicyName(policy)
+              << " sent=" << frames << " received=" << received
+              << " shared=" << shared << " out_of_order=" << outOfOrder
+              << " overwritten=" << overwritten
+              << " result=" << (passed ? "pass" : "fail") << "\n" << hpx::flush;
+    return passed;
+}
+
+// The same for the frames the processing of every camera received
+bool selftest_chains(const std::vector<CameraChain_SP>& chains)
+{
+    bool passed = true;
+    for (const CameraChain_SP& chain : chains)
+    {
+        ProcessingThread_SP processing = chain->getProcessingThread();
+        std::size_t measured = chain->getSamples().measured();
+        bool ok = measured > 0 && processing->getSharedFrames() == 0 &&
+                  processing->getOutOfOrderFrames() == 0;
+        hpx::cout << "[selftest] camera=" << chain->getIndex()
+                  << " measured=" << measured
+                  << " shared=" << processing->getSharedFrames()
+                  << " out_of_order=" << processing->getOutOfOrderFrames()
+                  << " result=" << (ok ? "pass" : "fail") << "\n" << hpx::flush;
+        passed = passed && ok;
+    }
+    return passed;
+}
+
+// A camera which fails after a few frames must end the capture and let
+// stop() return, with either pipeline. When stop() hangs the chain can't be
+// destroyed, the process exits right away.
+bool selftest_capture_error(const priority_lanes& lanes, bool dataflow)
+{
+    NullRenderer renderer;
+    CameraChainParams cp = params.chain;
+    cp.source = "synthetic://?fail=20";
+    cp.pipeline.dataflowPipeline = dataflow;
+    cp.pipeline.eventRecording.enabled = false;
+    CameraChain_SP chain = boost::make_shared<CameraChain>(0, cp, lanes, &renderer);
+    chain->start();
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (chain->isCapturing() && std::chrono::steady_clock::now() < deadline)
+        hpx::this_thread::sleep_for(std::chrono::milliseconds(10));
+    bool ended = !chain->isCapturing();
+
+    hpx::future<void> stopped = hpx::async(lanes.normal, [chain]() { chain->stop(); });
+    bool returned = stopped.wait_for(std::chrono::seconds(10)) ==
+                    hpx::lcos::future_status::ready;
+    bool passed = ended && returned;
+    hpx::cout << "[selftest] capture_error pipeline=" << (dataflow ? "dataflow" : "loops")
+              << " capture_ended=" << ended << " stop_returned=" << returned
+              << " result=" << (passed ? "pass" : "fail") << "\n" << hpx::flush;
+    if (!returned)
+        std::_Exit(1);
+    return passed;
+}
+
+///////////////////////////////////////////////////////////////////////////
+int hpx_main(int argc, char** argv)
+{
+    priority_lanes lanes("default", "blocking");
+
+    bool passed = true;
+    if (params.selftest)
+    {
+        for (BufferPolicy policy : {BufferPolicy::blockProducer, BufferPolicy::dropOldest,
+                                    BufferPolicy::dropNewest, BufferPolicy::latestOnly})
+            passed = selftest_buffer(lanes, policy) && passed;
+        passed = selftest_capture_error(lanes, false) && passed;
+        passed = selftest_capture_error(lanes, true) && passed;
+    }
+
+    // every camera its own chain on the shared pools, the sources are used
+    // in turn
+    NullRenderer renderer;
+    std::vector<CameraChain_SP> chains;
+    for (int i = 0; i < params.cameras; ++i)
+    {
+        CameraChainParams cp = params.chain;
+        cp.source = params.sources[i % params.sources.size()];
+        chains.push_back(boost::make_shared<CameraChain>(i, cp, lanes, &renderer));
+    }
+    for (const CameraChain_SP& chain : chains)
+        chain->start();
+
+    // run until enough frames were measured by every camera, the time is up
+    // or all sources ended
+    auto running = [&chains]() {
+        bool capturing = false, measuring = params.frames <= 0;
+        for (const CameraChain_SP& chain : chains)
+        {
+            capturing = capturing || chain->isCapturing();
+            measuring = measuring || chain->getSamples().measured() <
+                static_cast<std::size_t>(params.frames);
+        }
+        return capturing && measuring;
+    };
+    auto start = std::chrono::steady_clock::now();
+    auto deadline = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<double>(params.duration));
+    while (running() && std::chrono::steady_clock::now() < deadline)
+        hpx::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+    for (const CameraChain_SP& chain : chains)
+        chain->stop();
+
+    for (const CameraChain_SP& chain : chains)
+        print_summary(std::to_string(chain->getIndex()), chain->getParams(),
+            std::vector<CameraChain_SP>(1, chain));
+    if (chains.size() > 1)
+    {
+        CameraChainParams all = params.chain;
+        all.source = params.sources.size() == 1 ? params.sources[0] : "mixed";
+        print_summary("all", all, chains);
+    }
+
+    if (params.selftest)
+        passed = selftest_chains(chains) && passed;
+
+    chains.clear();    // waits for outstanding detections
+    int result = hpx::finalize();
+    return passed ? result : 1;
+}
+
+///////////////////////////////////////////////////////////////////////////
+int main(int argc, char* argv[])
+{
+    namespace po = boost::program_options;
+    po::options_description desc_cmdline("Options");
+    desc_cmdline.add_options()
+        ("blocking_tp_num_threads,m",
+         po::value<int>()->default_value(1),
+         "Number of threads to assign to blocking pool")
+        ("source",
+         po::value<std::vector<std::string>>()->composing()->default_value(
+             std::vector<std::string>{"synthetic://?motion=0.05"},
+             "synthetic://?motion=0.05"),
+         "Video file, camera URL, mjpeg:// file or synthetic:// source, "
+         "repeat for several cameras")
+        ("cameras", po::value<int>()->default_value(0),
+         "Number of camera chains, the sources are used in turn, 0 for one "
+         "per source")
+        ("width", po::value<int>()->default_value(640),
+         "Requested frame width")
+        ("height", po::value<int>()->default_value(480),
+         "Requested frame height")
+        ("rotation", po::value<int>()->default_value(0),
+         "Rotation of the frames, 0-3")
+        ("fps", po::value<int>()->default_value(30),
+         "Requested frames per second")
+        ("frames", po::value<int>()->default_value(0),
+         "Stop after this many measured frames, 0 for no limit")
+        ("selftest", po::value<bool>()->default_value(false),
+         "Check that every frame reaches the processing as the only owner of "
+         "its buffer and in capture order, through every buffer policy and "
+         "through the pipeline of the run, and that both pipelines stop "
+         "after a camera error, exit with 1 otherwise")
+        ("duration", po::value<double>()->default_value(10.0),
+         "Stop after this many seconds")
+        ("warmup", po::value<int>()->default_value(10),
+         "Frames rendered before the measurement starts")
+        ("processing", po::value<std::string>()->default_value("motion"),
+         "motion or face")
+        ("buffer-policy",
+         po::value<std::string>()->default_value("drop-oldest"),
+         "block-producer, drop-oldest, drop-newest or latest-only")
+        ("buffer-capacity", po::value<int>()->default_value(5),
+         "Number of frames buffered between capture and processing")
+        ("pipeline", po::value<std::string>()->default_value("loops"),
+         "loops or dataflow")
+        ("frames-in-flight", po::value<int>()->default_value(3),
+         "Frames in the dataflow pipeline at the same time")
+        ("face-recog-tasks", po::value<int>()->default_value(1),
+         "Frames detected at the same time by face recognition")
+        ("motion-kernel", po::value<std::string>()->default_value("opencv"),
+         "opencv, fused or compare")
+        ("background-model", po::value<std::string>()->default_value("float"),
+         "float or fixed16, used by the fused and compare motion kernels")
+        ("motion-luma", po::value<bool>()->default_value(false),
+         "Detect motion on grey frames only")
+        ("motion-pyramid", po::value<int>()->default_value(0),
+         "Coarse pass downscale factor, 4 or 8, 0 for none")
+        ("motion-skip-level", po::value<double>()->default_value(0.0),
+         "Mean absolute difference of static blocks skipped by the fused "
+         "motion kernel, 0 for none")
+        ("motion-blobs", po::value<bool>()->default_value(false),
+         "Label and track the connected regions of the motion mask")
+        ("morphology", po::value<std::string>()->default_value("opencv"),
+         "opencv, vhgw or compare, computation of the erode/dilate iterations")
+        ("erode", po::value<int>()->default_value(1),
+         "Erode iterations of motion detection")
+        ("dilate", po::value<int>()->default_value(0),
+         "Dilate iterations of motion detection")
+        ("record-events", po::value<bool>()->default_value(false),
+         "Record a clip of every motion event")
+        ("record-dir", po::value<std::string>()->default_value("."),
+         "Directory of the event clips")
+        ("record-pre", po::value<double>()->default_value(5.0),
+         "Seconds recorded before the motion started")
+        ("record-post", po::value<double>()->default_value(5.0),
+         "Seconds recorded after the motion ended")
+        ("record-trigger", po::value<double>()->default_value(50.0),
+         "Mean motion level (0-100) which starts an event")
+        ("record-quality", po::value<int>()->default_value(90),
+         "JPEG quality of the buffered frames")
+        ("record-max-mb", po::value<int>()->default_value(256),
+         "Megabytes of compressed frames held per camera")
+        ("detect-blocking", po::value<bool>()->default_value(false),
+         "Report tasks which run longer than blocking-threshold-ms without "
+         "yielding, per pool, at shutdown")
+        ("blocking-threshold-ms", po::value<double>()->default_value(50.0),
+         "Threshold used by detect-blocking");
+
+    po::variables_map vm;
+    try {
+        po::store(po::command_line_parser(argc, argv).allow_unregistered()
+                          .options(desc_cmdline).run(), vm);
+    }
+    catch(po::error& e) {
+        std::cerr << "ERROR: " << e.what() << "\n\n";
+        std::cerr << desc_cmdline << "\n";
+        return -1;
+    }
+
+    params.sources = vm["source"].as<std::vector<std::string>>();
+    params.cameras = vm["cameras"].as<int>();
+    if (params.cameras <= 0)
+        params.cameras = static_cast<int>(params.sources.size());
+    params.frames = vm["frames"].as<int>();
+    params.duration = vm["duration"].as<double>();
+    params.selftest = vm["selftest"].as<bool>();
+
+    CameraChainParams& chain = params.chain;
+    chain.size = cv::Size(vm["width"].as<int>(), vm["height"].as<int>());
+    chain.rotation = vm["rotation"].as<int>();
+    chain.fps = vm["fps"].as<int>();
+    chain.warmup = vm["warmup"].as<int>();
+    chain.pipeline.bufferCapacity = vm["buffer-capacity"].as<int>();
+    chain.pipeline.framesInFlight = vm["frames-in-flight"].as<int>();
+    chain.pipeline.faceRecogTasks = vm["face-recog-tasks"].as<int>();
+    chain.pipeline.motionLuma = vm["motion-luma"].as<bool>();
+    chain.pipeline.motionPyramid = vm["motion-pyramid"].as<int>();
+    chain.pipeline.motionSkipLevel = vm["motion-skip-level"].as<double>();
+    chain.pipeline.motionBlobs = vm["motion-blobs"].as<bool>();
+    EventRecorderParams& recording = chain.pipeline.eventRecording;
+    recording.enabled = vm["record-events"].as<bool>();
+    recording.directory = vm["record-dir"].as<std::string>();
+    recording.preTrigger = vm["record-pre"].as<double>();
+    recording.postTrigger = vm["record-post"].as<double>();
+    recording.triggerLevel = vm["record-trigger"].as<double>();
+    recording.jpegQuality = vm["record-quality"].as<int>();
+    recording.maxBytes = static_cast<std::size_t>(vm["record-max-mb"].as<int>()) << 20;
+    // the defaults of the settings widget
+    chain.motionFilter.threshold = 3;
+    chain.motionFilter.average = 0.2;
+    chain.motionFilter.erodeIterations = vm["erode"].as<int>();
+    chain.motionFilter.dilateIterations = vm["dilate"].as<int>();
+    chain.motionFilter.blendRatio = 0.7;
+    chain.motionFilter.displayImage = 0;
+    chain.faceRecogFilter.detectEyes = false;
+    chain.faceRecogFilter.decimationCoeff = 100;
+
+    std::string processing = vm["processing"].as<std::string>();
+    std::string pipeline = vm["pipeline"].as<std::string>();
+    bool valid = parseBufferPolicy(vm["buffer-policy"].as<std::string>(),
+                                   chain.pipeline.bufferPolicy) &&
+                 parseMotionKernel(vm["motion-kernel"].as<std::string>(),
+                                   chain.pipeline.motionKernel) &&
+                 parseBackgroundModel(vm["background-model"].as<std::string>(),
+                                      chain.pipeline.backgroundModel) &&
+                 parseMorphologyMethod(vm["morphology"].as<std::string>(),
+                                       chain.pipeline.morphology) &&
+                 chain.motionFilter.erodeIterations >= 0 &&
+                 chain.motionFilter.dilateIterations >= 0 &&
+                 (processing == "motion" || processing == "face") &&
+                 (pipeline == "loops" || pipeline == "dataflow") &&
+                 (chain.pipeline.motionPyramid == 0 || chain.pipeline.motionPyramid == 4 ||
+                  chain.pipeline.motionPyramid == 8) &&
+                 chain.fps > 0 && chain.rotation >= 0 && chain.rotation <= 3;
+    if (!valid) {
+        std::cerr << "ERROR: invalid option value\n\n";
+        std::cerr << desc_cmdline << "\n";
+        return -1;
+    }
+    if (chain.pipeline.motionPyramid > 1 &&
+        chain.pipeline.backgroundModel == BackgroundModel::fixed16) {
+        std::cerr << "ERROR: motion-pyramid keeps a float background, "
+                     "use background-model=float\n\n";
+        std::cerr << desc_cmdline << "\n";
+        return -1;
+    }
+    chain.processing = processing == "face" ? ProcessingType::faceRecognition
+                                            : ProcessingType::motionDetection;
+    chain.pipeline.dataflowPipeline = (pipeline == "dataflow");
+
+    // same pools as MartyCam
+    hpx::resource::partitioner rp(desc_cmdline, argc, argv);
+    rp.create_thread_pool("default",
+                          hpx::resource::scheduling_policy::local_priority_fifo);
+    rp.create_thread_pool("blocking",
+                          hpx::resource::scheduling_policy::local_priority_fifo);
+
+    int blocking_tp_num_threads = vm["blocking_tp_num_threads"].as<int>();
+    int count = 0;
+    for (const hpx::resource::numa_domain& d : rp.numa_domains())
+    {
+        for (const hpx::resource::core& c : d.cores())
+        {
+            for (const hpx::resource::pu& p : c.pus())
+            {
+                if (count < blocking_tp_num_threads)
+                {
+                    rp.add_resource(p, "blocking");
+                    count++;
+                }
+            }
+        }
+    }
+
+    if (vm["detect-blocking"].as<bool>())
+        blocking_detector::start(vm["blocking-threshold-ms"].as<double>(), {"blocking"});
+
+    int result = hpx::init(argc, argv);
+
+    blocking_detector::stop(std::cout);
+    return result;
+}
@@ -21,12 +21,19 @@ using hpx::util::high_resolution_timer;
 #include <opencv2/opencv.hpp>
 
 #include "capturethread.hpp"
-#include "ConcurrentCircularBuffer.hpp"
+#include "ConcurrentRingBuffer.hpp"
+#include "blocking_detector.hpp"
+#include "priority_lanes.hpp"
+#include "PipelineParams.hpp"
 #include  <boost/lockfree/queue.hpp>
 
 #include <chrono>
+#include <string>
 #include <thread>
 
+// set from the command line in main(), used by qt_main
+static PipelineParams pipelineParams;
+
 void qt_main(int argc, char ** argv)
 {
     //  QApplication app(nCmdShow, NULL);
@@ -37,11 +44,10 @@ void qt_main(int argc, char ** argv)
     //
     //
     //
-    hpx::threads::executors::pool_executor defaultExecutor("default");
-    hpx::threads::executors::pool_executor blockingExecutor("blocking");
-    hpx::cout << "[hpx_main] Created default and " << "blocking"
-              << " pool_executors \n";
-    MartyCam *tracker = new MartyCam(defaultExecutor, blockingExecutor);
+    priority_lanes lanes("default", "blocking");
+    hpx::cout << "[hpx_main] Created priority lanes on default and "
+              << "blocking" << " pools \n";
+    MartyCam *tracker = new MartyCam(lanes, pipelineParams);
     tracker->show();
     app.exec();
 }
@@ -65,7 +71,72 @@ int main(int argc, char **argv)
     desc_cmdline.add_options()
             ("blocking_tp_num_threads,m",
              po::value<int>()->default_value(1),
-             "Number of threads to assign to blocking pool");
+             "Number of threads to assign to blocking pool")
+            ("buffer-policy",
+             po::value<std::string>()->default_value("drop-oldest"),
+             "What the capture does when the processing falls behind: "
+             "block-producer, drop-oldest, drop-newest or latest-only")
+            ("buffer-capacity",
+             po::value<int>()->default_value(MartyCam::IMAGE_BUFF_CAPACITY),
+             "Number of frames buffered between capture and processing")
+            ("pipeline",
+             po::value<std::string>()->default_value("loops"),
+             "How frames move from capture to processing: loops (a capture "
+             "and a processing task connected by the buffer) or dataflow "
+             "(a chain of futures per frame)")
+            ("frames-in-flight",
+             po::value<int>()->default_value(3),
+             "Frames in the dataflow pipeline at the same time")
+            ("face-recog-tasks",
+             po::value<int>()->default_value(1),
+             "Frames detected at the same time by face recognition, the "
+             "results are displayed in capture order")
+            ("motion-kernel",
+             po::value<std::string>()->default_value("opencv"),
+             "How motion detection computes the threshold image: opencv (one "
+             "call per step), fused (a single pass over tiles of rows) or "
+             "compare (both, counting the pixels on which they differ)")
+            ("background-model",
+             po::value<std::string>()->default_value("float"),
+             "Moving average of the fused motion kernel: float (32 bit) or "
+             "fixed16 (16 bit fixed point)")
+            ("motion-luma", po::value<bool>()->default_value(false),
+             "Detect motion on the grey frames with a single channel "
+             "background, colour is only used for display")
+            ("motion-pyramid", po::value<int>()->default_value(0),
+             "Find motion on the frame downscaled by 4 or 8 and process only "
+             "the tiles with activity at full resolution, 0 for the whole frame")
+            ("motion-skip-level", po::value<double>()->default_value(0.0),
+             "Skip the 16x16 blocks whose mean absolute difference to the last "
+             "frame is at most this and which had no motion (fused motion "
+             "kernel), 0 to process every block")
+            ("motion-blobs", po::value<bool>()->default_value(false),
+             "Label the connected regions of the motion mask and track them "
+             "from frame to frame, their boxes are drawn on the preview")
+            ("morphology", po::value<std::string>()->default_value("opencv"),
+             "How the erode/dilate iterations are computed: opencv, vhgw "
+             "(van Herk/Gil-Werman, constant time in the number of "
+             "iterations) or compare (both, the results are compared)")
+            ("record-events", po::value<bool>()->default_value(false),
+             "Record a clip of every motion event, with the frames of the "
+             "seconds before it")
+            ("record-dir", po::value<std::string>()->default_value("."),
+             "Directory of the event clips")
+            ("record-pre", po::value<double>()->default_value(5.0),
+             "Seconds recorded before the motion started")
+            ("record-post", po::value<double>()->default_value(5.0),
+             "Seconds recorded after the motion ended")
+            ("record-trigger", po::value<double>()->default_value(50.0),
+             "Mean motion level (0-100, logarithmic) which starts an event")
+            ("record-quality", po::value<int>()->default_value(90),
+             "JPEG quality of the buffered frames")
+            ("record-max-mb", po::value<int>()->default_value(256),
+             "Megabytes of compressed frames held before frames are dropped")
+            ("detect-blocking", po::value<bool>()->default_value(false),
+             "Report tasks which run longer than blocking-threshold-ms without "
+             "yielding, per pool, at shutdown")
+            ("blocking-threshold-ms", po::value<double>()->default_value(50.0),
+             "Threshold used by detect-blocking");
 
     // HPX uses a boost program options variable map, but we need it before
     // hpx-main, so we will create another one here and throw it away after use
@@ -82,6 +153,72 @@ int main(int argc, char **argv)
 
     int blocking_tp_num_threads = vm["blocking_tp_num_threads"].as<int>();
 
+    if (!parseBufferPolicy(vm["buffer-policy"].as<std::string>(),
+                           pipelineParams.bufferPolicy)) {
+        std::cerr << "ERROR: unknown buffer policy "
+                  << vm["buffer-policy"].as<std::string>() << "\n\n";
+        std::cerr << desc_cmdline << "\n";
+        return -1;
+    }
+    pipelineParams.bufferCapacity = vm["buffer-capacity"].as<int>();
+
+    std::string pipeline = vm["pipeline"].as<std::string>();
+    if (pipeline != "loops" && pipeline != "dataflow") {
+        std::cerr << "ERROR: unknown pipeline " << pipeline << "\n\n";
+        std::cerr << desc_cmdline << "\n";
+        return -1;
+    }
+    pipelineParams.dataflowPipeline = (pipeline == "dataflow");
+    pipelineParams.framesInFlight = vm["frames-in-flight"].as<int>();
+    pipelineParams.faceRecogTasks = vm["face-recog-tasks"].as<int>();
+    pipelineParams.motionLuma = vm["motion-luma"].as<bool>();
+    pipelineParams.motionPyramid = vm["motion-pyramid"].as<int>();
+    pipelineParams.motionSkipLevel = vm["motion-skip-level"].as<double>();
+    pipelineParams.motionBlobs = vm["motion-blobs"].as<bool>();
+    EventRecorderParams &recording = pipelineParams.eventRecording;
+    recording.enabled = vm["record-events"].as<bool>();
+    recording.directory = vm["record-dir"].as<std::string>();
+    recording.preTrigger = vm["record-pre"].as<double>();
+    recording.postTrigger = vm["record-post"].as<double>();
+    recording.triggerLevel = vm["record-trigger"].as<double>();
+    recording.jpegQuality = vm["record-quality"].as<int>();
+    recording.maxBytes = static_cast<std::size_t>(vm["record-max-mb"].as<int>()) << 20;
+    if (pipelineParams.motionPyramid != 0 && pipelineParams.motionPyramid != 4 &&
+        pipelineParams.motionPyramid != 8) {
+        std::cerr << "ERROR: motion-pyramid must be 0, 4 or 8\n\n";
+        std::cerr << desc_cmdline << "\n";
+        return -1;
+    }
+
+    if (!parseMotionKernel(vm["motion-kernel"].as<std::string>(),
+                           pipelineParams.motionKernel)) {
+        std::cerr << "ERROR: unknown motion kernel "
+                  << vm["motion-kernel"].as<std::string>() << "\n\n";
+        std::cerr << desc_cmdline << "\n";
+        return -1;
+    }
+    if (!parseMorphologyMethod(vm["morphology"].as<std::string>(),
+                               pipelineParams.morphology)) {
+        std::cerr << "ERROR: unknown morphology "
+                  << vm["morphology"].as<std::string>() << "\n\n";
+        std::cerr << desc_cmdline << "\n";
+        return -1;
+    }
+    if (!parseBackgroundModel(vm["background-model"].as<std::string>(),
+                              pipelineParams.backgroundModel)) {
+        std::cerr << "ERROR: unknown background model "
+                  << vm["background-model"].as<std::string>() << "\n\n";
+        std::cerr << desc_cmdline << "\n";
+        return -1;
+    }
+    if (pipelineParams.motionPyramid > 1 &&
+        pipelineParams.backgroundModel == BackgroundModel::fixed16) {
+        std::cerr << "ERROR: motion-pyramid keeps a float background, "
+                     "use background-model=float\n\n";
+        std::cerr << desc_cmdline << "\n";
+        return -1;
+    }
+
     // Create the resource partitioner
     hpx::resource::partitioner rp(desc_cmdline, argc, argv);
     std::cout << "[main] obtained reference to the resource_partitioner\n";
@@ -116,5 +253,11 @@ int main(int argc, char **argv)
 
     std::cout << "[main] resources added to thread_pools \n";
 
-    return hpx::init(argc, argv);
+    if (vm["detect-blocking"].as<bool>())
+        blocking_detector::start(vm["blocking-threshold-ms"].as<double>(), {"blocking"});
+
+    int result = hpx::init(argc, argv);
+
+    blocking_detector::stop(std::cout);
+    return result;
 }
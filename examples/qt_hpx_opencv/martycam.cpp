@@ -1,6 +1,7 @@
 #include "martycam.hpp"
 #include "renderwidget.hpp"
 #include "settings.hpp"
+#include "FramePool.hpp"
 //
 #include <QToolBar>
 #include <QDockWidget>
@@ -14,11 +15,9 @@
 //----------------------------------------------------------------------------
 const int MartyCam::IMAGE_BUFF_CAPACITY = 5;
 
-MartyCam::MartyCam(const hpx::threads::executors::pool_executor& defaultExec,
-                   const hpx::threads::executors::pool_executor& blockingExec)
+MartyCam::MartyCam(const priority_lanes& lanes, const PipelineParams& pipelineParams)
         : captureThread(nullptr), processingThread(nullptr),
-          defaultExecutor(defaultExec), blockingExecutor(blockingExec),
-          QMainWindow(nullptr)
+          lanes(lanes), pipelineParams(pipelineParams), QMainWindow(nullptr)
 {
   this->ui.setupUi(this);
   //
@@ -29,7 +28,16 @@ MartyCam::MartyCam(const hpx::threads::executors::pool_executor& defaultExec,
   this->renderWidget = boost::make_shared<RenderWidget>(this);
   this->ui.gridLayout->addWidget(this->renderWidget.get(), 0, Qt::AlignHCenter || Qt::AlignTop);
 
-  this->imageBuffer = ImageBuffer(new ConcurrentCircularBuffer<cv::Mat>(IMAGE_BUFF_CAPACITY));
+  this->imageBuffer = ImageBuffer(new ConcurrentRingBuffer<Frame>(
+          this->pipelineParams.bufferCapacity, this->pipelineParams.bufferPolicy));
+  if (this->pipelineParams.dataflowPipeline) {
+    this->framePipeline = boost::make_shared<FramePipeline>(
+            this->lanes, this->pipelineParams.framesInFlight);
+  }
+  if (this->pipelineParams.eventRecording.enabled) {
+    this->eventRecorder = boost::make_shared<EventRecorder>(
+            this->pipelineParams.eventRecording, this->lanes);
+  }
 
   //
   // create a dock widget to hold the settings
@@ -41,7 +49,7 @@ MartyCam::MartyCam(const hpx::threads::executors::pool_executor& defaultExec,
   //
   // create the settings widget itself
   //
-  this->settingsWidget = boost::make_shared<SettingsWidget>(this);
+  this->settingsWidget = boost::make_shared<SettingsWidget>(this, this->lanes.blocking);
   this->settingsWidget->setRenderWidget(this->renderWidget.get());
   settingsDock->setWidget(this->settingsWidget.get());
   settingsDock->setMinimumWidth(300);
@@ -64,7 +72,7 @@ MartyCam::MartyCam(const hpx::threads::executors::pool_executor& defaultExec,
     while (!requestedSizeCorrect  && numeResolutionsToTry > 0) {
       // Loop over different resolutions to make sure the one supported by webcam is chosen
       cv::Size res = this->settingsWidget->getSelectedResolution();
-      this->createCaptureThread(res, this->cameraIndex, camerastring, blockingExecutor);
+      this->createCaptureThread(res, this->cameraIndex, camerastring, this->lanes.blocking);
       requestedSizeCorrect = captureThread->isRequestedSizeCorrect();
       if(!requestedSizeCorrect) {
         this->deleteCaptureThread();
@@ -82,7 +90,7 @@ MartyCam::MartyCam(const hpx::threads::executors::pool_executor& defaultExec,
   }
   if (this->captureThread->getImageSize().width > 0) {
     this->renderWidget->setCVSize(this->captureThread->getImageSize());
-    this->createProcessingThread(nullptr, defaultExecutor, this->settingsWidget->getCurentProcessingType());
+    this->createProcessingThread(nullptr, this->lanes.frame_critical, this->settingsWidget->getCurentProcessingType());
   }
   else {
     //abort if no camera devices connected
@@ -96,6 +104,9 @@ void MartyCam::closeEvent(QCloseEvent*) {
   this->settingsWidget->saveSettings();
   this->deleteCaptureThread();
   this->deleteProcessingThread();
+  if (this->eventRecorder) {
+    this->eventRecorder->finish();
+  }
 }
 //----------------------------------------------------------------------------
 void MartyCam::createCaptureThread(cv::Size &size, int camera, const std::string &cameraname,
@@ -103,8 +114,13 @@ void MartyCam::createCaptureThread(cv::Size &size, int camera, const std::string
 {
   this->captureThread =
           boost::make_shared<CaptureThread>(imageBuffer, size, this->settingsWidget->getSelectedRotation(),
-                                            camera, cameraname, this->blockingExecutor,
+                                            camera, cameraname, exec, this->lanes.blocking,
+                                            this->lanes.frame_critical,
                                             this->settingsWidget->getRequestedFps());
+  this->captureThread->setEventRecorder(this->eventRecorder);
+  if (this->framePipeline) {
+    this->framePipeline->setCaptureThread(this->captureThread);
+  }
   this->captureThread->startCapture();
   this->settingsWidget->setThreads(this->captureThread, this->processingThread);
 }
@@ -112,11 +128,14 @@ void MartyCam::createCaptureThread(cv::Size &size, int camera, const std::string
 void MartyCam::deleteCaptureThread()
 {
   this->captureThread->stopCapture();
+  if (this->framePipeline) {
+    this->framePipeline->setCaptureThread(nullptr);
+  }
   this->imageBuffer->clear();
   this->settingsWidget->unsetCaptureThread();
   this->captureThread = nullptr;
 
-  this->imageBuffer->send(cv::Mat());
+  this->imageBuffer->send(Frame());
 }
 //----------------------------------------------------------------------------
 void MartyCam::createProcessingThread(ProcessingThread *oldThread,
@@ -128,7 +147,14 @@ void MartyCam::createProcessingThread(ProcessingThread *oldThread,
     this->processingThread = boost::make_shared<ProcessingThread>(imageBuffer, exec, processingType, mfp, frfp);
   if (oldThread) this->processingThread->CopySettings(oldThread);
   this->processingThread->setRootFilter(renderWidget.get());
-  this->processingThread->startProcessing();
+  this->processingThread->setPipelineParams(this->pipelineParams);
+  this->processingThread->setEventRecorder(this->eventRecorder);
+  if (this->framePipeline) {
+    this->framePipeline->setProcessingThread(this->processingThread);
+  }
+  else {
+    this->processingThread->startProcessing();
+  }
 
   this->settingsWidget->setThreads(this->captureThread, this->processingThread);
   //
@@ -138,6 +164,9 @@ void MartyCam::createProcessingThread(ProcessingThread *oldThread,
 void MartyCam::deleteProcessingThread()
 {
   this->processingThread->stopProcessing();
+  if (this->framePipeline) {
+    this->framePipeline->setProcessingThread(nullptr);
+  }
   this->settingsWidget->unsetProcessingThread();
   this->processingThread = nullptr;
 }
@@ -187,17 +216,48 @@ void MartyCam::updateGUI() {
   //
   if (!this->processingThread) return;
 
-  statusBar()->showMessage(QString("FPS : %1 | Frame Counter : %2 "
+  int bufferCapacity = this->pipelineParams.bufferPolicy == BufferPolicy::latestOnly ?
+                       1 : this->pipelineParams.bufferCapacity;
+  QString message = QString("FPS : %1 | Frame Counter : %2 "
                                    "| Image Buffer Occupancy : %3\% "
                                    "| Sleep in CaptureThread: %4ms "
                                    "| Capture Time: %5ms "
-                                   "| Processing Time: %6ms").
+                                   "| Processing Time: %6ms "
+                                   "| Buffer (%7) Overwritten: %8 Dropped: %9 "
+                                   "Queue Delay: %10ms "
+                                   "| Frame Allocs/s: %11 "
+                                   "| Frame Jitter: %12ms").
     arg(this->captureThread->getActualFps(), 5, 'f', 2).
     arg(captureThread->GetFrameCounter(), 5).
-    arg(100 * (float)this->imageBuffer->size()/IMAGE_BUFF_CAPACITY, 4).
+    arg(100 * (float)this->imageBuffer->size()/bufferCapacity, 4).
     arg(captureThread->getSleepTime()).
     arg(captureThread->getCaptureTime()).
-    arg(processingThread->getProcessingTime()));
+    arg(processingThread->getProcessingTime()).
+    arg(bufferPolicyName(this->imageBuffer->getPolicy())).
+    arg(this->imageBuffer->getOverwritten()).
+    arg(this->imageBuffer->getDropped()).
+    arg(this->imageBuffer->getQueueDelay_us() / 1000.0, 0, 'f', 1).
+    arg(FramePool::instance().getAllocationsPerSecond(), 0, 'f', 1).
+    arg(captureThread->getFrameJitter_ms(), 0, 'f', 2);
+  if (this->pipelineParams.motionSkipLevel > 0) {
+    message += QString(" | Skipped Blocks: %1\%").
+      arg(100.0 * this->processingThread->getSkippedBlocks(), 0, 'f', 1);
+  }
+  if (this->eventRecorder) {
+    message += QString(" | Events: %1%2 Dropped: %3").
+      arg(this->eventRecorder->getEvents()).
+      arg(this->eventRecorder->isRecording() ? " (recording)" : "").
+      arg(this->eventRecorder->getDroppedFrames());
+  }
+  if (this->pipelineParams.motionBlobs) {
+    message += QString(" | Blobs: %1").arg(this->processingThread->getTrackedBlobs());
+  }
+  if (this->framePipeline) {
+    message += QString(" | Frames In Flight: %1/%2").
+      arg(this->framePipeline->getFramesInFlight()).
+      arg(this->framePipeline->getMaxFramesInFlight());
+  }
+  statusBar()->showMessage(message);
 }
 //----------------------------------------------------------------------------
 void MartyCam::clearGraphs()
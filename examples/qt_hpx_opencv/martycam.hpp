@@ -15,6 +15,9 @@
 #include "renderwidget.hpp"
 #include "processingthread.hpp"
 #include "settings.hpp"
+#include "priority_lanes.hpp"
+#include "PipelineParams.hpp"
+#include "FramePipeline.hpp"
 //
 #include <boost/make_shared.hpp>
 
@@ -27,7 +30,7 @@ typedef boost::shared_ptr<QDockWidget> QDockWidget_SP;
 class MartyCam : public QMainWindow {
 Q_OBJECT
 public:
-  MartyCam(const hpx::threads::executors::pool_executor&, const hpx::threads::executors::pool_executor&);
+  MartyCam(const priority_lanes& lanes, const PipelineParams& pipelineParams);
 
   void loadSettings();
   void saveSettings();
@@ -62,9 +65,11 @@ public:
   int                      cameraIndex;
 
   ImageBuffer              imageBuffer;
+  FramePipeline_SP         framePipeline;
+  EventRecorder_SP         eventRecorder;
 
-  hpx::threads::executors::pool_executor blockingExecutor;
-  hpx::threads::executors::pool_executor defaultExecutor;
+  priority_lanes           lanes;
+  PipelineParams           pipelineParams;
 };
 
 #endif
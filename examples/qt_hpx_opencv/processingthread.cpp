@@ -10,8 +10,15 @@
 //
 #include "filter.hpp"
 //
+#include <cstdint>
+#include <exception>
+#include <mutex>
+//
 #include <hpx/lcos/future.hpp>
+#include <hpx/include/apply.hpp>
 #include <hpx/include/async.hpp>
+//
+#include "blocking_detector.hpp"
 #include <utility> //----------------------------------------------------------------------------
 ProcessingThread::ProcessingThread(ImageBuffer buffer,
                                    hpx::threads::executors::pool_executor exec,
@@ -22,10 +29,14 @@ ProcessingThread::ProcessingThread(ImageBuffer buffer,
           motionFilter(new MotionFilter(mfp)),
           faceRecogFilter(new FaceRecogFilter(frfp)),
           abort(false), processingType(processingType), processingTimes(15), processingTime_ms(0),
+          lastSequence(0), processedFrames(0), sharedFrames(0), outOfOrderFrames(0),
+          faceRecogTasks(1), detectionsInFlight(0), nextTicket(0), nextDelivery(0),
           QObject(nullptr) {}
 //----------------------------------------------------------------------------
 ProcessingThread::~ProcessingThread()
 {
+  // the detections refer to the filter
+  this->waitForDetections();
 }
 //----------------------------------------------------------------------------
 void ProcessingThread::CopySettings(ProcessingThread *thread)
@@ -37,6 +48,28 @@ void ProcessingThread::CopySettings(ProcessingThread *thread)
   this->motionFilter->dilateIterations =  thread->motionFilter->dilateIterations;
   this->motionFilter->displayImage =  thread->motionFilter->displayImage;
   this->motionFilter->blendRatio =  thread->motionFilter->blendRatio;
+  this->motionFilter->kernel =  thread->motionFilter->kernel;
+  this->motionFilter->backgroundModel =  thread->motionFilter->backgroundModel;
+  this->motionFilter->lumaOnly =  thread->motionFilter->lumaOnly;
+  this->motionFilter->pyramidScale =  thread->motionFilter->pyramidScale;
+  this->motionFilter->skipLevel =  thread->motionFilter->skipLevel;
+  this->motionFilter->trackBlobs =  thread->motionFilter->trackBlobs;
+  this->motionFilter->morphologyMethod =  thread->motionFilter->morphologyMethod;
+}
+//----------------------------------------------------------------------------
+void ProcessingThread::setPipelineParams(const PipelineParams &params)
+{
+  this->setFaceRecogTasks(params.faceRecogTasks);
+  this->setMotionKernel(params.motionKernel);
+  this->setBackgroundModel(params.backgroundModel);
+  this->setLumaOnly(params.motionLuma);
+  this->setPyramidScale(params.motionPyramid);
+  this->setSkipLevel(params.motionSkipLevel);
+  this->setTrackBlobs(params.motionBlobs);
+  this->setMorphologyMethod(params.morphology);
+  if (params.eventRecording.enabled) {
+    this->motionFilter->triggerLevel = params.eventRecording.triggerLevel;
+  }
 }
 //----------------------------------------------------------------------------
 void ProcessingThread::setMotionDetectionProcessing(){
@@ -47,44 +80,142 @@ void ProcessingThread::setFaceRecognitionProcessing(){
 }
 //----------------------------------------------------------------------------
 void ProcessingThread::run() {
-  int framenum = 0;
-  QTime processingTime;
-  processingTime.start();
-
   while (!this->abort) {
     // blocking : waits until next image is available if necessary
-    cv::Mat cameraImage = imageBuffer->receive();
-    // if camera not working or disconnected, abort
-    if (cameraImage.empty()) {
-      boost::this_thread::sleep(boost::posix_time::milliseconds(100));
+    Frame frame = imageBuffer->receive();
+    // the empty frames only wake the loop to look at abort, receive()
+    // suspends the task while there is nothing to process
+    if (frame.image.empty()) {
       continue;
     }
-    cv::Mat cameracopy = cameraImage.clone();
-
-    processingTime.restart();
-    switch(this->processingType){
-        case ProcessingType::motionDetection :
-          this->motionFilter->process(cameracopy);
-          break;
-        case ProcessingType ::faceRecognition :
-          this->faceRecogFilter->process(cameracopy);
-          break;
-    }
-    updateProcessingTime(processingTime.elapsed());
-    emit (NewData());
+    this->processFrame(frame);
   }
 
+  this->waitForDetections();
   this->abort = false;
+  // stopProcessing() holds the lock until it waits, so the wakeup can't be lost
+  QMutexLocker lock(&this->stopLock);
   this->stopWait.wakeAll();
 }
 //----------------------------------------------------------------------------
+void ProcessingThread::processFrame(Frame &frame) {
+  // The capture stage handed the frame over, the filters may draw on it
+  // in place. Count the frames breaking that: a buffer someone else still
+  // holds, or a frame arriving after a later one. martycam_headless
+  // --selftest fails on either.
+  if (frame.image.u != nullptr && frame.image.u->refcount != 1) {
+    this->sharedFrames++;
+  }
+  if (this->processedFrames > 0 && frame.sequence <= this->lastSequence) {
+    this->outOfOrderFrames++;
+  }
+  frame.receivedTime = Frame::clock::now();
+  this->lastSequence = frame.sequence;
+  this->processedFrames++;
+
+  if (this->processingType == ProcessingType::faceRecognition && this->faceRecogTasks > 1) {
+    this->detectFacesAsync(frame);
+    return;
+  }
+  // frames still being detected go to the renderer first
+  this->waitForDetections();
+
+  QTime processingTime;
+  processingTime.start();
+  switch(this->processingType){
+      case ProcessingType::motionDetection :
+        this->motionFilter->process(frame.image);
+        if (this->eventRecorder) {
+          this->eventRecorder->trigger(this->motionFilter->eventLevel > 0, frame.captureTime);
+        }
+        break;
+      case ProcessingType ::faceRecognition :
+        this->faceRecogFilter->process(frame.image);
+        break;
+  }
+  updateProcessingTime(processingTime.elapsed());
+  if (this->frameObserver) {
+    this->frameObserver(frame, Frame::clock::now());
+  }
+  emit (NewData());
+}
+//----------------------------------------------------------------------------
+void ProcessingThread::setFaceRecogTasks(int n) {
+  this->faceRecogTasks = n > 1 ? n : 1;
+  this->faceRecogFilter->reserveClassifiers(this->faceRecogTasks);
+}
+//----------------------------------------------------------------------------
+// Waits for a free slot and starts the detection of the frame. The frames
+// get a ticket in the order they arrive, which is capture order, and
+// deliverFrame() renders them by ticket.
+void ProcessingThread::detectFacesAsync(Frame &frame) {
+  std::uint64_t ticket;
+  {
+    std::unique_lock<mutex_type> lk(this->detectionsLock);
+    while (this->detectionsInFlight >= this->faceRecogTasks) {
+      this->detectionDelivered.wait(lk);
+    }
+    this->detectionsInFlight++;
+    ticket = this->nextTicket++;
+  }
+
+  Frame detected = std::move(frame);
+  hpx::apply(this->executor, blocking_detector::annotate("ProcessingThread::detectFaces",
+                                                         [this, ticket, detected]() {
+    QTime processingTime;
+    processingTime.start();
+    try {
+      this->faceRecogFilter->detect(detected.image);
+    }
+    catch (const std::exception &e) {
+      std::cout << "Face recognition failed: " << e.what() << std::endl;
+    }
+    this->deliverFrame(ticket, detected, processingTime.elapsed());
+  }));
+}
+//----------------------------------------------------------------------------
+void ProcessingThread::deliverFrame(std::uint64_t ticket, const Frame &frame, int time_ms) {
+  int delivered = 0;
+  {
+    std::lock_guard<mutex_type> lk(this->detectionsLock);
+    this->reorderBuffer.emplace(ticket, frame);
+    // render under the lock, the renderer takes one frame at a time
+    while (!this->reorderBuffer.empty() &&
+           this->reorderBuffer.begin()->first == this->nextDelivery) {
+      this->faceRecogFilter->render(this->reorderBuffer.begin()->second.image);
+      if (this->frameObserver) {
+        this->frameObserver(this->reorderBuffer.begin()->second, Frame::clock::now());
+      }
+      this->reorderBuffer.erase(this->reorderBuffer.begin());
+      this->nextDelivery++;
+      this->detectionsInFlight--;
+      delivered++;
+    }
+    updateProcessingTime(time_ms);
+    if (delivered > 0) {
+      this->detectionDelivered.notify_all();
+    }
+  }
+  for (int i = 0; i < delivered; ++i) {
+    emit (NewData());
+  }
+}
+//----------------------------------------------------------------------------
+void ProcessingThread::waitForDetections() {
+  std::unique_lock<mutex_type> lk(this->detectionsLock);
+  while (this->detectionsInFlight > 0) {
+    this->detectionDelivered.wait(lk);
+  }
+}
+//----------------------------------------------------------------------------
 bool ProcessingThread::startProcessing()
 {
   if (!processingActive) {
     processingActive = true;
     abort = false;
 
-    hpx::async(this->executor, &ProcessingThread::run, this);
+    hpx::async(this->executor,
+               blocking_detector::annotate("ProcessingThread::run", &ProcessingThread::run), this);
 
     return true;
   }
@@ -4,6 +4,8 @@
 #include <hpx/config.hpp>
 #include <hpx/parallel/execution.hpp>
 #include <hpx/parallel/executors/pool_executor.hpp>
+#include <hpx/lcos/local/condition_variable.hpp>
+#include <hpx/lcos/local/mutex.hpp>
 //
 #include <QMutex>
 #include <QWaitCondition>
@@ -13,8 +15,15 @@
 #include <QtCore/QObject>
 //
 #include <boost/shared_ptr.hpp>
-#include "ConcurrentCircularBuffer.hpp"
-typedef boost::shared_ptr< ConcurrentCircularBuffer<cv::Mat> > ImageBuffer;
+#include "ConcurrentRingBuffer.hpp"
+#include "Frame.hpp"
+#include <boost/circular_buffer.hpp>
+//
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <map>
+typedef boost::shared_ptr< ConcurrentRingBuffer<Frame> > ImageBuffer;
 typedef boost::circular_buffer< int > IntCircBuff;
 class ProcessingThread;
 typedef boost::shared_ptr<ProcessingThread> ProcessingThread_SP;
@@ -22,6 +31,7 @@ typedef boost::shared_ptr<ProcessingThread> ProcessingThread_SP;
 class Filter;
 #include "MotionFilter.hpp"
 #include "FaceRecogFilter.hpp"
+#include "PipelineParams.hpp"
 
 enum class ProcessingType: int
 {
@@ -48,12 +58,44 @@ public:
   void setDilateIterations(int val) { this->motionFilter->dilateIterations = val; }
   void setDisplayImage(int image) { this->motionFilter->displayImage = image; }
   void setBlendRatios(double ratio1) { this->motionFilter->blendRatio = ratio1; }
+  void setMotionKernel(MotionKernel kernel) { this->motionFilter->kernel = kernel; }
+  void setBackgroundModel(BackgroundModel model) { this->motionFilter->backgroundModel = model; }
+  void setLumaOnly(bool luma) { this->motionFilter->lumaOnly = luma; }
+  void setPyramidScale(int scale) { this->motionFilter->pyramidScale = scale; }
+  void setSkipLevel(double level) { this->motionFilter->skipLevel = level; }
+  void setTrackBlobs(bool track) { this->motionFilter->trackBlobs = track; }
+  void setMorphologyMethod(MorphologyMethod method) { this->motionFilter->morphologyMethod = method; }
+  // told about the motion events of every frame
+  void setEventRecorder(EventRecorder_SP recorder) { this->eventRecorder = recorder; }
+  // the processing settings of the command line
+  void setPipelineParams(const PipelineParams &params);
   //
   void setEyesRecogState(int val) { this->faceRecogFilter->setEyesRecogState((bool)val); }
   void setDecimationCoeff(int val) {
     this->faceRecogFilter->setDecimationCoeff(val); }
   int getProcessingTime() { return this->processingTime_ms; }
+  // fraction of the blocks skipped by motion detection since the start
+  double getSkippedBlocks() {
+    return this->motionFilter->blocksTotal>0 ?
+      static_cast<double>(this->motionFilter->blocksSkipped)/this->motionFilter->blocksTotal : 0.0; }
+  // blobs tracked in the last frame of motion detection
+  int getTrackedBlobs() { return this->motionFilter->trackedBlobs; }
+  // frames whose buffer had another owner when they arrived, and frames
+  // which arrived after a later one; both must stay 0
+  std::int64_t getSharedFrames() { return this->sharedFrames; }
+  std::int64_t getOutOfOrderFrames() { return this->outOfOrderFrames; }
   void run();
+  // one iteration of run(), also called by FramePipeline
+  void processFrame(Frame &frame);
+  // Face recognition keeps no state between frames: with n > 1, up to n
+  // frames are detected concurrently and passed to the renderer in the
+  // order they were received.
+  void setFaceRecogTasks(int n);
+  int  getFaceRecogTasks() { return this->faceRecogTasks; }
+  // called for every frame after it was passed to the renderer, with the
+  // time it was rendered; used for latency measurements
+  typedef std::function<void(const Frame &frame, Frame::clock::time_point rendered)> FrameObserver;
+  void setFrameObserver(FrameObserver observer) { this->frameObserver = std::move(observer); }
   bool startProcessing();
   bool stopProcessing();
 
@@ -66,7 +108,12 @@ signals:
     void NewData();
 
 private:
+  typedef hpx::lcos::local::mutex mutex_type;
+
   void updateProcessingTime(int time_ms);
+  void detectFacesAsync(Frame &frame);
+  void deliverFrame(std::uint64_t ticket, const Frame &frame, int time_ms);
+  void waitForDetections();
 
   //
   QMutex           stopLock;
@@ -79,6 +126,23 @@ private:
   ProcessingType processingType;
   int processingTime_ms;
   IntCircBuff processingTimes;
+  std::uint64_t lastSequence;
+  std::uint64_t processedFrames;
+  std::atomic<std::int64_t> sharedFrames;
+  std::atomic<std::int64_t> outOfOrderFrames;
+  //
+  // concurrent face recognition
+  //
+  int           faceRecogTasks;
+  mutex_type    detectionsLock;
+  hpx::lcos::local::condition_variable detectionDelivered;
+  int           detectionsInFlight;     // received and not yet delivered
+  std::uint64_t nextTicket;
+  std::uint64_t nextDelivery;
+  std::map<std::uint64_t, Frame> reorderBuffer;
+  //
+  FrameObserver frameObserver;
+  EventRecorder_SP eventRecorder;
 };
 
 #endif
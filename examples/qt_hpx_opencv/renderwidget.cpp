@@ -6,6 +6,7 @@
 #include <QMouseEvent>
 //
 #include <iostream>
+#include <utility>
 //
 #include <opencv2/imgproc/imgproc.hpp>
 //----------------------------------------------------------------------------
@@ -27,12 +28,11 @@ cv::Mat QImage2IplImage(QImage *qimg)
 // this->thresholdImage = cvCreateImage( imageSize, IPL_DEPTH_8U, 1);
 //----------------------------------------------------------------------------
 template <typename T>
-QImage *cvMat2QImage(const cv::Mat &mat)
+void cvMat2QImage(const cv::Mat &mat, QImage *qimg)
 {
   int h = mat.size().height;
   int w = mat.size().width;
   int channels = mat.channels();
-  QImage *qimg = new QImage(w, h, QImage::Format_ARGB32);
   const T *data = reinterpret_cast<const T *>(mat.data);
   //
   for (int y=0; y<h; y++, data+=mat.step[0]/sizeof(T)) {
@@ -56,8 +56,6 @@ QImage *cvMat2QImage(const cv::Mat &mat)
       }
     }
   }
-
-  return qimg;
 }
 //----------------------------------------------------------------------------
 RenderWidget::RenderWidget(QWidget* parent) : QWidget(parent), Filter(), imageValid(1)
@@ -69,6 +67,7 @@ RenderWidget::RenderWidget(QWidget* parent) : QWidget(parent), Filter(), imageVa
   connect(this, SIGNAL(update_signal(bool, int)), this, SLOT(UpdateTrigger(bool, int)), Qt::QueuedConnection);
   //
   this->bufferImage = NULL;
+  this->backImage = NULL;
 }
 //----------------------------------------------------------------------------
 void RenderWidget::setCVSize(const cv::Size &size)
@@ -80,28 +79,35 @@ void RenderWidget::onFrameSizeChanged(int width, int height) {
   this->setFixedSize(width, height);
 }
 //----------------------------------------------------------------------------
+// Converts into the back image and swaps it with the displayed one. The two
+// images are reused and only reallocated when the frame size changes.
 void RenderWidget::updatePixmap(const cv::Mat &frame)
 {
-  QImage *temp = this->bufferImage;
-  imageValid.acquire();
+  if (!this->backImage || this->backImage->width() != frame.cols ||
+      this->backImage->height() != frame.rows) {
+    delete this->backImage;
+    this->backImage = new QImage(frame.cols, frame.rows, QImage::Format_ARGB32);
+  }
 
   int bytes = frame.elemSize();
   int bytes_per_channel = bytes/frame.channels();
 
   if (bytes_per_channel==1) {
-    this->bufferImage = cvMat2QImage<unsigned char>(frame);
+    cvMat2QImage<unsigned char>(frame, this->backImage);
   }
   else if (bytes_per_channel==2) {
-    this->bufferImage = cvMat2QImage<short>(frame);
+    cvMat2QImage<short>(frame, this->backImage);
   }
   else if (bytes_per_channel==4) {
-    this->bufferImage = cvMat2QImage<float>(frame);
+    cvMat2QImage<float>(frame, this->backImage);
   }
   else if (bytes_per_channel==8) {
-    this->bufferImage = cvMat2QImage<double>(frame);
+    cvMat2QImage<double>(frame, this->backImage);
   }
+
+  imageValid.acquire();
+  std::swap(this->bufferImage, this->backImage);
   imageValid.release();
-  delete temp;
 }
 //----------------------------------------------------------------------------
 void RenderWidget::process(const cv::Mat &image) {
@@ -38,6 +38,7 @@ protected:
 
 private:
   QImage         *bufferImage;
+  QImage         *backImage;
   QSemaphore      imageValid;
 };
 
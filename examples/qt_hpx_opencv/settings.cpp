@@ -14,13 +14,17 @@
 #include <opencv2/highgui/highgui_c.h>
 #include <QString>
 //
+#include <hpx/include/apply.hpp>
+#include <utility>
+//
 // we need these to get access to videoInput
 // Caution: including cpp file here as routines are not exported from openCV
 //#include "../../highgui/src/precomp.hpp"
 //#include "../../highgui/src/cap_dshow.cpp"
 
 //----------------------------------------------------------------------------
-SettingsWidget::SettingsWidget(QWidget* parent) : QWidget(parent)
+SettingsWidget::SettingsWidget(QWidget* parent, hpx::threads::executors::pool_executor ioExec)
+        : QWidget(parent), ioExecutor(std::move(ioExec))
 {
 //  this->processingthread = NULL;
 //  this->capturethread    = NULL;
@@ -406,9 +410,13 @@ void SettingsWidget::onSnapClicked()
 {
   QPixmap p = this->renderWidget->grab();
   QString filename = QString("%1/MartySnap-%2").arg(this->ui.avi_directory->text()).arg(SnapshotId++, 3, 10, QChar('0')) + QString(".png");
-  p.save(filename);
   QClipboard *clipboard = QApplication::clipboard();
   clipboard->setPixmap(p);
+  // PNG encoding takes long at high resolutions and the file is written to
+  // disk, do it on the blocking lane instead of the GUI thread. QImage
+  // (unlike QPixmap) may be used off the GUI thread.
+  QImage image = p.toImage();
+  hpx::apply(this->ioExecutor, [image, filename]() { image.save(filename); });
 }
 //---------------------------------------------------------------------------
 void SettingsWidget::onTabChanged(int currentTabIndex){
@@ -5,6 +5,9 @@
 #include "capturethread.hpp"
 #include "processingthread.hpp"
 #include "MotionFilter.hpp"
+//
+#include <hpx/parallel/executors/pool_executor.hpp>
+//
 #include <QDateTime>
 #include <QTimer>
 #include <QButtonGroup>
@@ -41,7 +44,7 @@ QMySignalBlocker<T> SilentCall(T* o)
 class SettingsWidget : public QWidget {
 Q_OBJECT;
 public:
-  SettingsWidget(QWidget* parent);
+  SettingsWidget(QWidget* parent, hpx::threads::executors::pool_executor ioExec);
 
   cv::Size  getSelectedResolution();
   int getSelectedResolutionButton();
@@ -117,6 +120,7 @@ protected:
   RenderWidget       *renderWidget;
   IPCameraForm       *cameraForm;
   int                 NumDevices;
+  hpx::threads::executors::pool_executor ioExecutor;     // snapshot writes
   //
   bool                faceRecognitionAcitve;
   int                 requestedFps;
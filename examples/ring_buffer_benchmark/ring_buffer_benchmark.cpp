@@ -0,0 +1,205 @@
+#include <hpx/hpx_init.hpp>
+//
+#include <hpx/include/async.hpp>
+#include <hpx/include/lcos.hpp>
+#include <hpx/include/threads.hpp>
+#include <hpx/util/high_resolution_timer.hpp>
+//
+#include <hpx/include/iostreams.hpp>
+//
+#include "ConcurrentCircularBuffer.hpp"
+#include "ConcurrentRingBuffer.hpp"
+//
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////
+/// Function Declarations
+
+template <typename Buffer>
+double measure_throughput(Buffer& buffer, int num_producers,
+    int num_consumers, double duration_s, std::int64_t& overwritten);
+
+template <typename Buffer>
+std::vector<double> measure_wakeup_latency(Buffer& buffer, int num_wakeups);
+
+template <typename Buffer>
+void run_benchmark(const std::string& name, int capacity, int num_producers,
+    int num_consumers, double duration_s, int num_wakeups);
+
+///////////////////////////////////////////////////////////////////////////
+/// Function Definitions
+
+typedef std::chrono::steady_clock clock_type;
+
+// marks the end of the stream for the consumers
+static const std::int64_t end_of_stream = -1;
+
+// Producers send as fast as they can for duration_s, consumers receive
+// until they get end_of_stream. Returns the received elements per second,
+// the elements overwritten in a full buffer are returned in overwritten.
+template <typename Buffer>
+double measure_throughput(Buffer& buffer, int num_producers,
+    int num_consumers, double duration_s, std::int64_t& overwritten)
+{
+    std::atomic<bool> stop(false);
+    std::atomic<std::int64_t> sent(0);
+    std::atomic<std::int64_t> received(0);
+    std::atomic<int> consumers_running(num_consumers);
+
+    std::vector<hpx::future<void>> tasks;
+    for (int c = 0; c < num_consumers; ++c)
+    {
+        tasks.push_back(hpx::async([&]() {
+            while (buffer.receive() != end_of_stream)
+                ++received;
+            --consumers_running;
+        }));
+    }
+
+    hpx::util::high_resolution_timer timer;
+    for (int p = 0; p < num_producers; ++p)
+    {
+        tasks.push_back(hpx::async([&]() {
+            std::int64_t n = 0;
+            while (!stop)
+            {
+                buffer.send(n++);
+                // let the consumers run when sharing a worker thread
+                if ((n & 0xff) == 0)
+                    hpx::this_thread::yield();
+            }
+            sent += n;
+        }));
+    }
+
+    hpx::this_thread::sleep_for(std::chrono::duration<double>(duration_s));
+    stop = true;
+    double elapsed = timer.elapsed();
+
+    // a full buffer overwrites, keep sending until every consumer got one
+    while (consumers_running != 0)
+    {
+        buffer.send(end_of_stream);
+        hpx::this_thread::yield();
+    }
+    hpx::wait_all(tasks);
+
+    buffer.clear();
+    overwritten = sent - received;
+    return received / elapsed;
+}
+
+// A single consumer waits on the empty buffer, the producer sends its
+// timestamp after a short pause. Returns the time from send() to the return
+// of receive() in microseconds, sorted.
+template <typename Buffer>
+std::vector<double> measure_wakeup_latency(Buffer& buffer, int num_wakeups)
+{
+    std::vector<double> latencies;
+    latencies.reserve(num_wakeups);
+
+    hpx::future<void> consumer = hpx::async([&]() {
+        for (int i = 0; i < num_wakeups; ++i)
+        {
+            std::int64_t sent_at = buffer.receive();
+            std::int64_t now =
+                clock_type::now().time_since_epoch().count();
+            latencies.push_back(
+                std::chrono::duration<double, std::micro>(
+                    clock_type::duration(now - sent_at)).count());
+        }
+    });
+
+    for (int i = 0; i < num_wakeups; ++i)
+    {
+        // give the consumer time to go to sleep on the empty buffer
+        hpx::this_thread::sleep_for(std::chrono::milliseconds(1));
+        buffer.send(clock_type::now().time_since_epoch().count());
+    }
+    consumer.get();
+
+    std::sort(latencies.begin(), latencies.end());
+    return latencies;
+}
+
+template <typename Buffer>
+void run_benchmark(const std::string& name, int capacity, int num_producers,
+    int num_consumers, double duration_s, int num_wakeups)
+{
+    Buffer buffer(capacity);
+
+    std::int64_t overwritten = 0;
+    double ops = measure_throughput(
+        buffer, num_producers, num_consumers, duration_s, overwritten);
+    std::vector<double> latencies =
+        measure_wakeup_latency(buffer, num_wakeups);
+
+    // single line summary
+    hpx::cout << "[ring-buffer] buffer=" << name << " capacity=" << capacity
+              << " producers=" << num_producers
+              << " consumers=" << num_consumers << " ops_per_s=" << ops
+              << " overwritten=" << overwritten
+              << " wakeup_p50_us=" << latencies[latencies.size() / 2]
+              << " wakeup_p99_us=" << latencies[(latencies.size() * 99) / 100]
+              << " wakeup_max_us=" << latencies.back() << "\n"
+              << hpx::flush;
+}
+
+///////////////////////////////////////////////////////////////////////////
+int hpx_main(boost::program_options::variables_map& vm)
+{
+    int capacity = vm["capacity"].as<int>();
+    int num_producers = vm["producers"].as<int>();
+    int num_consumers = vm["consumers"].as<int>();
+    double duration_s = vm["duration"].as<double>();
+    int num_wakeups = vm["wakeups"].as<int>();
+
+    hpx::cout << "HPX using threads = " << hpx::get_num_worker_threads()
+              << "\n";
+
+    run_benchmark<ConcurrentRingBuffer<std::int64_t>>("ConcurrentRingBuffer",
+        capacity, num_producers, num_consumers, duration_s, num_wakeups);
+
+    // ConcurrentCircularBuffer blocks the worker OS thread in receive(), the
+    // producers starve when the consumers occupy every worker
+    if (hpx::get_num_worker_threads() <
+        static_cast<std::size_t>(num_producers + num_consumers + 1))
+    {
+        hpx::cout << "Skipping ConcurrentCircularBuffer, it needs at least "
+                  << num_producers + num_consumers + 1 << " threads\n";
+    }
+    else
+    {
+        run_benchmark<ConcurrentCircularBuffer<std::int64_t>>(
+            "ConcurrentCircularBuffer", capacity, num_producers,
+            num_consumers, duration_s, num_wakeups);
+    }
+
+    return hpx::finalize();
+}
+
+///////////////////////////////////////////////////////////////////////////
+int main(int argc, char* argv[])
+{
+    namespace po = boost::program_options;
+    po::options_description desc_cmdline("Options");
+    desc_cmdline.add_options()
+        ("capacity", po::value<int>()->default_value(5),
+         "Capacity of the buffers")
+        ("producers", po::value<int>()->default_value(1),
+         "Number of producer tasks")
+        ("consumers", po::value<int>()->default_value(1),
+         "Number of consumer tasks")
+        ("duration", po::value<double>()->default_value(2.0),
+         "Duration of the throughput measurement in seconds")
+        ("wakeups", po::value<int>()->default_value(1000),
+         "Number of wakeups of a consumer waiting on an empty buffer");
+
+    return hpx::init(desc_cmdline, argc, argv);
+}